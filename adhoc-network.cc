@@ -57,6 +57,10 @@
 // Note that certain mobility patterns may cause packet forwarding
 // to fail (if nodes become disconnected)
 
+#include <chrono>
+#include <limits>
+#include <memory>
+
 #include "ns3/command-line.h"
 #include "ns3/string.h"
 #include "ns3/yans-wifi-helper.h"
@@ -77,6 +81,14 @@
 #include "ns3/applications-module.h"
 #include "ns3/animation-interface.h"
 
+#include "backbone-energy.h"
+#include "batched-output.h"
+#include "batch-scheduler.h"
+#include "prebuilt-install.h"
+#include "role-tracing.h"
+#include "scenario-runner.h"
+#include "static-arp.h"
+
 using namespace ns3;
 
 //
@@ -84,6 +96,51 @@ using namespace ns3;
 //
 NS_LOG_COMPONENT_DEFINE ("AdhocNetwork");
 
+//
+// Simulation defaults, set before the command line arguments are parsed
+//
+static void
+SetDefaults (void)
+{
+  Config::SetDefault ("ns3::OnOffApplication::PacketSize", StringValue ("1472"));
+  Config::SetDefault ("ns3::OnOffApplication::DataRate", StringValue ("100kb/s"));
+}
+
+//
+// Count the echo replies received by the client
+//
+static void
+EchoReply (uint32_t *replies, Ptr<const Packet> packet)
+{
+  (*replies)++;
+}
+
+//
+// What the trace sinks of one run write to.  The sinks stay connected
+// until the nodes are destroyed, which the runner only does when it
+// resets the simulator before the next run, or after the last; so the
+// state of a run is kept until the next run replaces it.
+//
+struct RunState
+{
+  RunState ()
+    : anim (0),
+      echoReplies (0)
+  {
+  }
+
+  ~RunState ()
+  {
+    delete anim;
+  }
+
+  BatchedOutput traceFile;        //!< trace file, with --batchedOutput
+  RoleTracer roleTracer;          //!< role traces
+  BackboneEnergy backboneEnergy;  //!< backbone energy models and log
+  AnimationInterface *anim;       //!< NetAnim output, single runs only
+  uint32_t echoReplies;           //!< echo replies received
+};
+
 int
 main (int argc, char *argv[])
 {
@@ -94,13 +151,27 @@ main (int argc, char *argv[])
   uint32_t backboneNodes = 10;
   uint32_t infraNodes = 2;
   uint32_t stopTime = 20;
+  std::string traceRoles = "";
+  std::string traceMode = "ascii";
+  uint32_t traceSample = 100;
+  bool energy = false;
+  double initialEnergy = 100.0;
+  double energyResolution = 0.5;
+  bool preAssociated = false;
+  bool beaconEconomy = false;
+  bool prebuiltMobility = false;
+  bool staticArp = false;
+  bool reportEvents = false;
+  bool probes = false;
+  bool batchedOutput = false;
+  std::string scheduler = "ns3::MapScheduler";
+  uint32_t runs = 1;
 
   //
   // Simulation defaults are typically set next, before command line
   // arguments are parsed.
   //
-  Config::SetDefault ("ns3::OnOffApplication::PacketSize", StringValue ("1472"));
-  Config::SetDefault ("ns3::OnOffApplication::DataRate", StringValue ("100kb/s"));
+  SetDefaults ();
 
   //
   // For convenience, we add the local variables to the command line argument
@@ -111,6 +182,33 @@ main (int argc, char *argv[])
   cmd.AddValue ("backboneNodes", "number of backbone nodes", backboneNodes);
   cmd.AddValue ("infraNodes", "number of leaf nodes", infraNodes);
   cmd.AddValue ("stopTime", "simulation stop time (seconds)", stopTime);
+  cmd.AddValue ("traceRoles", "trace only these role:layer[-event] items, e.g. backbone:mac-drop,sta:app-rx "
+                "(roles: all, backbone, sta; empty traces everything)", traceRoles);
+  cmd.AddValue ("traceMode", "ascii (one line per packet), sample (one packet uid in traceSample), "
+                "aggregate (packets and bytes per role, node and event every 100 ms) or usdt (fire the "
+                "ns3sim:packet probe, no file output)", traceMode);
+  cmd.AddValue ("traceSample", "sampling period used by traceMode=sample", traceSample);
+  cmd.AddValue ("energy", "power the backbone routers from batteries and log their energy", energy);
+  cmd.AddValue ("initialEnergy", "battery capacity of each backbone router (J)", initialEnergy);
+  cmd.AddValue ("energyResolution", "smallest energy drop written to the energy log (J)", energyResolution);
+  cmd.AddValue ("preAssociated", "turn the infrastructure nets into ad hoc nets (AdhocWifiMac), with "
+                "no beacon, probe or association exchanges and no relaying by the router, so traffic can "
+                "flow from t=0; do not compare the results with access point runs", preAssociated);
+  cmd.AddValue ("beaconEconomy", "do not simulate access point beacons; stations find their access "
+                "point by active probing instead", beaconEconomy);
+  cmd.AddValue ("prebuiltMobility", "configure the station mobility model once, not per "
+                "infrastructure net; this renumbers later random streams, so results differ", prebuiltMobility);
+  cmd.AddValue ("staticArp", "fill the ARP caches of all on-link neighbors before the run", staticArp);
+  cmd.AddValue ("reportEvents", "print the number of events executed and the event rate", reportEvents);
+  cmd.AddValue ("probes", "fire the ns3sim event probes (USDT) from the scheduler", probes);
+  cmd.AddValue ("batchedOutput", "write the trace file in large batches from a background "
+                "writer instead of line by line", batchedOutput);
+  cmd.AddValue ("scheduler", "event scheduler type, e.g. ns3::MapScheduler (the default), "
+                "ns3::HeapScheduler, ns3::CalendarScheduler or ns3::BatchScheduler, which "
+                "keeps same-timestamp events in one batch", scheduler);
+  cmd.AddValue ("runs", "number of runs, starting from RngRun, made in this process; with more "
+                "than one, every output file is suffixed with its run number and a summary "
+                "of the runs is printed", runs);
   //
   // The system global variables and the local values added to the argument
   // system can be overridden by command line arguments by using this call.
@@ -122,255 +220,436 @@ main (int argc, char *argv[])
       std::cout << "Use a simulation stop time >= 10 seconds" << std::endl;
       exit (1);
     }
-  ///////////////////////////////////////////////////////////////////////////
-  //                                                                       //
-  // Construct the backbone                                                //
-  //                                                                       //
-  ///////////////////////////////////////////////////////////////////////////
-
-  //
-  // Create a container to manage the nodes of the adhoc (backbone) network.
-  // Later we'll create the rest of the nodes we'll need.
-  //
-  NodeContainer allInfras;
-  NetDeviceContainer allInfraDevices;
-
-  NodeContainer backbone;
-  backbone.Create (backboneNodes);
-  //
-  // Create the backbone wifi net devices and install them into the nodes in
-  // our container
-  //
-  WifiHelper wifi;
-  WifiMacHelper mac;
-  mac.SetType ("ns3::AdhocWifiMac");
-  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
-                                "DataMode", StringValue ("OfdmRate54Mbps"));
-  YansWifiPhyHelper wifiPhy;
-  wifiPhy.SetPcapDataLinkType (WifiPhyHelper::DLT_IEEE802_11_RADIO);
-  YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
-  wifiPhy.SetChannel (wifiChannel.Create ());
-  NetDeviceContainer backboneDevices = wifi.Install (wifiPhy, mac, backbone);
-
-  // We enable OLSR (which will be consulted at a higher priority than
-  // the global routing) on the backbone ad hoc nodes
-  NS_LOG_INFO ("Enabling OLSR routing on all backbone nodes");
-  OlsrHelper olsr;
   //
-  // Add the IPv4 protocol stack to the nodes in our container
+  // The rest of the script is one run of the scenario; the runner repeats
+  // it --runs times in this process, with consecutive RNG run numbers
   //
-  InternetStackHelper internet;
-  internet.SetRoutingHelper (olsr); // has effect on the next Install ()
-  internet.Install (backbone);
+  std::unique_ptr<RunState> state;
+  ScenarioRunner runner;
+  runner.SetConfigure ([&] ()
+    {
+      SetDefaults ();
+      cmd.Parse (argc, argv);
+    });
+  std::vector<ScenarioMetrics> results = runner.Run ([&] (uint64_t run, ScenarioMetrics &metrics)
+    {
+      // The simulator was reset, so the previous run's state can go
+      state.reset (new RunState);
+      std::string prefix = "adhoc-network";
+      if (runs > 1)
+        {
+          std::stringstream runSuffix;
+          runSuffix << "-run" << run;
+          prefix += runSuffix.str ();
+        }
 
-  //
-  // Assign IPv4 addresses to the device drivers (actually to the associated
-  // IPv4 interfaces) we just created.
-  //
-  Ipv4AddressHelper ipAddrs;
-  ipAddrs.SetBase ("192.168.0.0", "255.255.255.0");
-  ipAddrs.Assign (backboneDevices);
+      ///////////////////////////////////////////////////////////////////////////
+      //                                                                       //
+      // Construct the backbone                                                //
+      //                                                                       //
+      ///////////////////////////////////////////////////////////////////////////
 
-  //
-  // The ad-hoc network nodes need a mobility model so we aggregate one to
-  // each of the nodes we just finished building.
-  //
-  MobilityHelper mobility;
-  mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
-                                 "MinX", DoubleValue (20.0),
-                                 "MinY", DoubleValue (20.0),
-                                 "DeltaX", DoubleValue (20.0),
-                                 "DeltaY", DoubleValue (20.0),
-                                 "GridWidth", UintegerValue (5),
-                                 "LayoutType", StringValue ("RowFirst"));
-  mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
-                             "Bounds", RectangleValue (Rectangle (-500, 500, -500, 500)),
-                             "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=2]"),
-                             "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.2]"));
-  mobility.Install (backbone);
-
-  ///////////////////////////////////////////////////////////////////////////
-  //                                                                       //
-  // Construct the mobile networks                                         //
-  //                                                                       //
-  ///////////////////////////////////////////////////////////////////////////
-
-  // Reset the address base-- all of the 802.11 networks will be in
-  // the "10.0" address space
-  ipAddrs.SetBase ("10.0.0.0", "255.255.255.0");
-
-  for (uint32_t i = 0; i < backboneNodes; ++i)
-    {
-      NS_LOG_INFO ("Configuring wireless network for backbone node " << i);
       //
-      // Create a container to manage the nodes of the LAN.  We need
-      // two containers here; one with all of the new nodes, and one
-      // with all of the nodes including new and existing nodes
+      // Create a container to manage the nodes of the adhoc (backbone) network.
+      // Later we'll create the rest of the nodes we'll need.
       //
-      NodeContainer stas;
-      stas.Create (infraNodes - 1);
-      // Now, create the container with all nodes on this link
-      NodeContainer infra (backbone.Get (i), stas);
+      NodeContainer allInfras;
+      NetDeviceContainer allInfraDevices;
+
+      NodeContainer backbone;
+      backbone.Create (backboneNodes);
       //
-      // Create an infrastructure network
+      // Create the backbone wifi net devices and install them into the nodes in
+      // our container
       //
-      WifiHelper wifiInfra;
-      WifiMacHelper macInfra;
+      WifiHelper wifi;
+      WifiMacHelper mac;
+      mac.SetType ("ns3::AdhocWifiMac");
+      wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
+                                    "DataMode", StringValue ("OfdmRate54Mbps"));
+      YansWifiPhyHelper wifiPhy;
+      wifiPhy.SetPcapDataLinkType (WifiPhyHelper::DLT_IEEE802_11_RADIO);
+      YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
       wifiPhy.SetChannel (wifiChannel.Create ());
-      // Create unique ssids for these networks
-      std::string ssidString ("wifi-infra");
-      std::stringstream ss;
-      ss << i;
-      ssidString += ss.str ();
-      Ssid ssid = Ssid (ssidString);
-      // setup stas
-      macInfra.SetType ("ns3::StaWifiMac",
-                        "Ssid", SsidValue (ssid));
-      NetDeviceContainer staDevices = wifiInfra.Install (wifiPhy, macInfra, stas);
-      // setup ap.
-      macInfra.SetType ("ns3::ApWifiMac",
-                        "Ssid", SsidValue (ssid));
-      NetDeviceContainer apDevices = wifiInfra.Install (wifiPhy, macInfra, backbone.Get (i));
-      // Collect all of these new devices
-      NetDeviceContainer infraDevices (apDevices, staDevices);
+      NetDeviceContainer backboneDevices = wifi.Install (wifiPhy, mac, backbone);
 
+      // We enable OLSR (which will be consulted at a higher priority than
+      // the global routing) on the backbone ad hoc nodes
+      NS_LOG_INFO ("Enabling OLSR routing on all backbone nodes");
+      OlsrHelper olsr;
+      //
       // Add the IPv4 protocol stack to the nodes in our container
       //
-      internet.Install (stas);
+      InternetStackHelper internet;
+      internet.SetRoutingHelper (olsr); // has effect on the next Install ()
+      internet.Install (backbone);
+
       //
       // Assign IPv4 addresses to the device drivers (actually to the associated
       // IPv4 interfaces) we just created.
       //
-      ipAddrs.Assign (infraDevices);
+      Ipv4AddressHelper ipAddrs;
+      ipAddrs.SetBase ("192.168.0.0", "255.255.255.0");
+      ipAddrs.Assign (backboneDevices);
+
       //
-      // Assign a new network prefix for each mobile network, according to
-      // the network mask initialized above
+      // The ad-hoc network nodes need a mobility model so we aggregate one to
+      // each of the nodes we just finished building.
       //
-      ipAddrs.NewNetwork ();
+      MobilityHelper mobility;
+      mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
+                                     "MinX", DoubleValue (20.0),
+                                     "MinY", DoubleValue (20.0),
+                                     "DeltaX", DoubleValue (20.0),
+                                     "DeltaY", DoubleValue (20.0),
+                                     "GridWidth", UintegerValue (5),
+                                     "LayoutType", StringValue ("RowFirst"));
+      mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
+                                 "Bounds", RectangleValue (Rectangle (-500, 500, -500, 500)),
+                                 "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=2]"),
+                                 "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.2]"));
+      mobility.Install (backbone);
+
+      ///////////////////////////////////////////////////////////////////////////
+      //                                                                       //
+      // Construct the mobile networks                                         //
+      //                                                                       //
+      ///////////////////////////////////////////////////////////////////////////
+
+      // Reset the address base-- all of the 802.11 networks will be in
+      // the "10.0" address space
+      ipAddrs.SetBase ("10.0.0.0", "255.255.255.0");
+
       //
-      // The new wireless nodes need a mobility model so we aggregate one
-      // to each of the nodes we just finished building.
+      // The infrastructure nets only differ in their channel and SSID, so the
+      // helpers are configured once, here, and each net's SSID is set on its
+      // MACs once they are installed
       //
-      Ptr<ListPositionAllocator> subnetAlloc =
-        CreateObject<ListPositionAllocator> ();
-      for (uint32_t j = 0; j < infra.GetN (); ++j)
+      WifiHelper wifiInfra;
+      WifiMacHelper macSta;
+      WifiMacHelper macAp;
+      if (preAssociated)
         {
-          subnetAlloc->Add (Vector (0.0, j * 10 + 10, 0.0));
+          //
+          // StaWifiMac has no way to be handed its association state, so
+          // the router and its stations share the channel through a MAC
+          // that needs no association at all.  Channel and PHY are those
+          // of the access point, but this is an IBSS: frames go straight
+          // between stations, not relayed by the router, with ad hoc
+          // addressing, so the MAC behaves differently from a BSS.
+          //
+          macSta.SetType ("ns3::AdhocWifiMac");
+          macAp.SetType ("ns3::AdhocWifiMac");
+        }
+      else if (beaconEconomy)
+        {
+          //
+          // Without beacons the stations probe for their access point,
+          // and must not give up on it for missing beacons
+          //
+          macSta.SetType ("ns3::StaWifiMac",
+                          "ActiveProbing", BooleanValue (true),
+                          "MaxMissedBeacons", UintegerValue (std::numeric_limits<uint32_t>::max ()));
+          macAp.SetType ("ns3::ApWifiMac",
+                         "BeaconGeneration", BooleanValue (false));
+        }
+      else
+        {
+          macSta.SetType ("ns3::StaWifiMac");
+          macAp.SetType ("ns3::ApWifiMac");
+        }
+
+      for (uint32_t i = 0; i < backboneNodes; ++i)
+        {
+          NS_LOG_INFO ("Configuring wireless network for backbone node " << i);
+          //
+          // Create a container to manage the nodes of the LAN.  We need
+          // two containers here; one with all of the new nodes, and one
+          // with all of the nodes including new and existing nodes
+          //
+          NodeContainer stas;
+          stas.Create (infraNodes - 1);
+          // Now, create the container with all nodes on this link
+          NodeContainer infra (backbone.Get (i), stas);
+          //
+          // Create an infrastructure network
+          //
+          wifiPhy.SetChannel (wifiChannel.Create ());
+          // Create unique ssids for these networks
+          std::string ssidString ("wifi-infra");
+          std::stringstream ss;
+          ss << i;
+          ssidString += ss.str ();
+          Ssid ssid = Ssid (ssidString);
+          // setup stas
+          NetDeviceContainer staDevices = InstallWithSsid (wifiInfra, wifiPhy, macSta, stas, ssid);
+          // setup ap.
+          NetDeviceContainer apDevices = InstallWithSsid (wifiInfra, wifiPhy, macAp, backbone.Get (i), ssid);
+          // Collect all of these new devices
+          NetDeviceContainer infraDevices (apDevices, staDevices);
+
+          // Add the IPv4 protocol stack to the nodes in our container
+          //
+          internet.Install (stas);
+          //
+          // Assign IPv4 addresses to the device drivers (actually to the associated
+          // IPv4 interfaces) we just created.
+          //
+          ipAddrs.Assign (infraDevices);
+          //
+          // Assign a new network prefix for each mobile network, according to
+          // the network mask initialized above
+          //
+          ipAddrs.NewNetwork ();
+          //
+          // The new wireless nodes need a mobility model so we aggregate one
+          // to each of the nodes we just finished building.
+          //
+          Ptr<ListPositionAllocator> subnetAlloc =
+            CreateObject<ListPositionAllocator> ();
+          for (uint32_t j = 0; j < infra.GetN (); ++j)
+            {
+              subnetAlloc->Add (Vector (0.0, j * 10 + 10, 0.0));
+            }
+          mobility.PushReferenceMobilityModel (backbone.Get (i));
+          mobility.SetPositionAllocator (subnetAlloc);
+          if (i == 0 || !prebuiltMobility)
+            {
+              //
+              // Configuring the model creates its two constant random variables,
+              // each taking the next random stream.  Doing it for every net, as
+              // the script always has, keeps the streams of all later random
+              // variables, and so the results of default runs, unchanged.
+              //
+              mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
+                                         "Bounds", RectangleValue (Rectangle (-10, 10, -10, 10)),
+                                         "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=3]"),
+                                         "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.4]"));
+            }
+          mobility.Install (stas);
+          mobility.PopReferenceMobilityModel ();
+
+          allInfras.Add (stas);
+          allInfraDevices.Add (infraDevices);
+        }
+
+      if (staticArp)
+        {
+          //
+          // Every address is assigned by now, so the ARP caches can be filled
+          // from the address plan instead of by ARP exchanges
+          //
+          uint32_t arpEntries = PopulateArpCaches ();
+          NS_LOG_INFO ("Added " << arpEntries << " static ARP entries");
         }
-      mobility.PushReferenceMobilityModel (backbone.Get (i));
-      mobility.SetPositionAllocator (subnetAlloc);
-      mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
-                                 "Bounds", RectangleValue (Rectangle (-10, 10, -10, 10)),
-                                 "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=3]"),
-                                 "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.4]"));
-      mobility.Install (stas);
 
+      if (beaconEconomy && !preAssociated)
+        {
+          //
+          // A beacon of about 100 bytes at the 6 Mb/s OFDM basic rate is 20 us
+          // of preamble and header plus 35 symbols of 4 us, sent every 102.4 ms
+          //
+          NS_LOG_INFO ("Beacons are not simulated; they would take " << 100 * 160e-6 / 102.4e-3
+                       << "% of the airtime of each infrastructure channel");
+        }
+
+      ///////////////////////////////////////////////////////////////////////////
+      //                                                                       //
+      // Energy configuration                                                  //
+      //                                                                       //
+      ///////////////////////////////////////////////////////////////////////////
+
+      //
+      // The backbone routers run on batteries that feed both of their wifi
+      // radios.  Energy is accounted on radio state changes only.
       //
+      BackboneEnergy &backboneEnergy = state->backboneEnergy;
+      if (energy)
+        {
+          NS_LOG_INFO ("Installing energy models on the backbone routers");
+          backboneEnergy.Install (backbone, initialEnergy, Seconds (stopTime));
+          backboneEnergy.EnableLog (prefix + ".energy", energyResolution);
+        }
+      /*
+      ///////////////////////////////////////////////////////////////////////////
+      //                                                                       //
+      // Application configuration                                             //
+      //                                                                       //
+      ///////////////////////////////////////////////////////////////////////////
+      */
+
+      UdpEchoServerHelper echoServer (9);
+
+      Ptr<Node> serverNode = NodeList::GetNode (backboneNodes);
+
+      ApplicationContainer serverApps = echoServer.Install (serverNode);
+      serverApps.Start (Seconds (1.0));
+      serverApps.Stop (Seconds (10.0));
+
+      uint32_t lastNodeIndex = backboneNodes + backboneNodes * (infraNodes - 1) - 1;
+      Ptr<Node> clientNode = NodeList::GetNode (lastNodeIndex);
+
+      Node sNode = *serverNode;
+
+      UdpEchoClientHelper echoClient ( (*sNode.GetDevice(0)).GetAddress(), 9);
+      echoClient.SetAttribute ("MaxPackets", UintegerValue (1));
+      echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
+      echoClient.SetAttribute ("PacketSize", UintegerValue (1024));
+
+      ApplicationContainer clientApps = echoClient.Install (clientNode);
+      clientApps.Start (Seconds (2.0));
+      clientApps.Stop (Seconds (10.0));
+      clientApps.Get (0)->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&EchoReply, &state->echoReplies));
+
+      // ----------------------------------------------------------
+      /*
+      // Create the OnOff application to send UDP datagrams of size
+      // 210 bytes at a rate of 10 Kb/s, between two nodes
+      // We'll send data from the first wired LAN node on the first wired LAN
+      // to the last wireless STA on the last infrastructure net, thereby
+      // causing packets to traverse CSMA to adhoc to infrastructure links
+
+      NS_LOG_INFO ("Create Applications.");
+      uint16_t port = 9;   // Discard port (RFC 863)
+
+      // Let's make sure that the user does not define too few nodes
+      // to make this example work.  We need infraNodes > 1
+      NS_ASSERT (infraNodes > 1);
+      // We want the source to be the first node created outside of the backbone
+      // Conveniently, the variable "backboneNodes" holds this node index value
+      Ptr<Node> appSource = NodeList::GetNode (backboneNodes);
+      // We want the sink to be the last node created in the topology.
+      uint32_t lastNodeIndex = backboneNodes + backboneNodes * (infraNodes - 1) - 1;
+      Ptr<Node> appSink = NodeList::GetNode (lastNodeIndex);
+      // Let's fetch the IP address of the last node, which is on Ipv4Interface 1
+      Ipv4Address remoteAddr = appSink->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+
+      OnOffHelper onoff ("ns3::UdpSocketFactory",
+                         Address (InetSocketAddress (remoteAddr, port)));
+
+      ApplicationContainer apps = onoff.Install (appSource);
+      apps.Start (Seconds (3));
+      apps.Stop (Seconds (stopTime - 1));
+
+      // Create a packet sink to receive these packets
+      PacketSinkHelper sink ("ns3::UdpSocketFactory",
+                             InetSocketAddress (Ipv4Address::GetAny (), port));
+      apps = sink.Install (appSink);
+      apps.Start (Seconds (3));*/
+
+      ///////////////////////////////////////////////////////////////////////////
+      //                                                                       //
+      // Tracing configuration                                                 //
+      //                                                                       //
+      ///////////////////////////////////////////////////////////////////////////
+
+      NS_LOG_INFO ("Configure Tracing.");
+      CsmaHelper csma;
 
-      NodeContainer allInfras (stas, allInfras);
-      NetDeviceContainer allInfraDevices (infraDevices, allInfraDevices);
-    }
-/*
-  ///////////////////////////////////////////////////////////////////////////
-  //                                                                       //
-  // Application configuration                                             //
-  //                                                                       //
-  ///////////////////////////////////////////////////////////////////////////
-*/
-  
-  UdpEchoServerHelper echoServer (9);
-
-  Ptr<Node> serverNode = NodeList::GetNode (backboneNodes);
-
-  ApplicationContainer serverApps = echoServer.Install (serverNode);
-  serverApps.Start (Seconds (1.0));
-  serverApps.Stop (Seconds (10.0));
-
-  uint32_t lastNodeIndex = backboneNodes + backboneNodes * (infraNodes - 1) - 1;
-  Ptr<Node> clientNode = NodeList::GetNode (lastNodeIndex);
-
-  Node sNode = *serverNode;
-
-  UdpEchoClientHelper echoClient ( (*sNode.GetDevice(0)).GetAddress(), 9);
-  echoClient.SetAttribute ("MaxPackets", UintegerValue (1));
-  echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
-  echoClient.SetAttribute ("PacketSize", UintegerValue (1024));
-
-  ApplicationContainer clientApps = echoClient.Install (clientNode);
-  clientApps.Start (Seconds (2.0));
-  clientApps.Stop (Seconds (10.0));
-
-  // ----------------------------------------------------------
-/*  
-  // Create the OnOff application to send UDP datagrams of size
-  // 210 bytes at a rate of 10 Kb/s, between two nodes
-  // We'll send data from the first wired LAN node on the first wired LAN
-  // to the last wireless STA on the last infrastructure net, thereby
-  // causing packets to traverse CSMA to adhoc to infrastructure links
-
-  NS_LOG_INFO ("Create Applications.");
-  uint16_t port = 9;   // Discard port (RFC 863)
-
-  // Let's make sure that the user does not define too few nodes
-  // to make this example work.  We need infraNodes > 1
-  NS_ASSERT (infraNodes > 1);
-  // We want the source to be the first node created outside of the backbone
-  // Conveniently, the variable "backboneNodes" holds this node index value
-  Ptr<Node> appSource = NodeList::GetNode (backboneNodes);
-  // We want the sink to be the last node created in the topology.
-  uint32_t lastNodeIndex = backboneNodes + backboneNodes * (infraNodes - 1) - 1;
-  Ptr<Node> appSink = NodeList::GetNode (lastNodeIndex);
-  // Let's fetch the IP address of the last node, which is on Ipv4Interface 1
-  Ipv4Address remoteAddr = appSink->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
-
-  OnOffHelper onoff ("ns3::UdpSocketFactory",
-                     Address (InetSocketAddress (remoteAddr, port)));
-
-  ApplicationContainer apps = onoff.Install (appSource);
-  apps.Start (Seconds (3));
-  apps.Stop (Seconds (stopTime - 1));
-
-  // Create a packet sink to receive these packets
-  PacketSinkHelper sink ("ns3::UdpSocketFactory",
-                         InetSocketAddress (Ipv4Address::GetAny (), port));
-  apps = sink.Install (appSink);
-  apps.Start (Seconds (3));*/
-
-  ///////////////////////////////////////////////////////////////////////////
-  //                                                                       //
-  // Tracing configuration                                                 //
-  //                                                                       //
-  ///////////////////////////////////////////////////////////////////////////
-
-  NS_LOG_INFO ("Configure Tracing.");
-  CsmaHelper csma;
+      //
+      // Let's set up some ns-2-like ascii traces, using another helper class
+      //
+      AsciiTraceHelper ascii;
+      BatchedOutput &traceFile = state->traceFile;
+      Ptr<OutputStreamWrapper> stream;
+      // In usdt mode the probes replace the trace file
+      bool writeTraceFile = traceMode != "usdt";
+      if (writeTraceFile && batchedOutput)
+        {
+          traceFile.Open (prefix + ".tr");
+          stream = Create<OutputStreamWrapper> (traceFile.GetStream ());
+        }
+      else if (writeTraceFile)
+        {
+          stream = ascii.CreateFileStream (prefix + ".tr");
+        }
+      RoleTracer &roleTracer = state->roleTracer;
+      if (traceRoles.empty () && traceMode == "ascii")
+        {
+          wifiPhy.EnableAsciiAll (stream);
+          csma.EnableAsciiAll (stream);
+          internet.EnableAsciiIpv4All (stream);
+        }
+      else
+        {
+          //
+          // Only connect the trace sources that were asked for, on the nodes
+          // playing the requested roles
+          //
+          roleTracer.AddRole ("all", NodeContainer::GetGlobal ());
+          roleTracer.AddRole ("backbone", backbone);
+          roleTracer.AddRole ("sta", allInfras);
+          if (traceMode == "sample")
+            {
+              roleTracer.SetSampling (traceSample);
+            }
+          else if (traceMode == "aggregate")
+            {
+              roleTracer.SetAggregation (MilliSeconds (100));
+            }
+          else if (traceMode == "usdt")
+            {
+              roleTracer.SetUsdt ();
+            }
+          else if (traceMode != "ascii")
+            {
+              NS_ABORT_MSG ("Unknown traceMode \"" << traceMode << "\"");
+            }
+          // Without explicit roles, cover what the global ascii trace would
+          roleTracer.Enable (traceRoles.empty () ? "all:mac,all:ip" : traceRoles, stream);
+          NS_LOG_INFO ("Connected " << roleTracer.GetNBindings () << " role trace sinks");
+        }
 
-  //
-  // Let's set up some ns-2-like ascii traces, using another helper class
-  //
-  AsciiTraceHelper ascii;
-  Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream ("adhoc-network.tr");
-  wifiPhy.EnableAsciiAll (stream);
-  csma.EnableAsciiAll (stream);
-  internet.EnableAsciiIpv4All (stream);
-
-  // Csma captures in non-promiscuous mode
-  csma.EnablePcapAll ("adhoc-network", false);
-  // pcap captures on the backbone wifi devices
-  wifiPhy.EnablePcap ("adhoc-network", backboneDevices, false);
-  // pcap trace on the application data sink
-  // wifiPhy.EnablePcap ("adhoc-network", appSink->GetId (), 0);
-
-  AnimationInterface anim ("adhoc-network.xml");
-
-  ///////////////////////////////////////////////////////////////////////////
-  //                                                                       //
-  // Run simulation                                                        //
-  //                                                                       //
-  ///////////////////////////////////////////////////////////////////////////
-
-  NS_LOG_INFO ("Run Simulation.");
-  Simulator::Stop (Seconds (stopTime));
-  Simulator::Run ();
-  Simulator::Destroy ();
+      // Csma captures in non-promiscuous mode
+      csma.EnablePcapAll (prefix, false);
+      // pcap captures on the backbone wifi devices
+      wifiPhy.EnablePcap (prefix, backboneDevices, false);
+      // pcap trace on the application data sink
+      // wifiPhy.EnablePcap ("adhoc-network", appSink->GetId (), 0);
+
+      // NetAnim follows a single run only
+      if (runs == 1)
+        {
+          state->anim = new AnimationInterface ("adhoc-network.xml");
+        }
+
+      ///////////////////////////////////////////////////////////////////////////
+      //                                                                       //
+      // Run simulation                                                        //
+      //                                                                       //
+      ///////////////////////////////////////////////////////////////////////////
+
+      if (probes)
+        {
+          NS_ABORT_MSG_IF (!ProbedScheduler::IsAvailable (), "Built without <sys/sdt.h>, no probes to fire");
+          ObjectFactory probed ("ns3::ProbedScheduler");
+          probed.Set ("Inner", StringValue (scheduler));
+          Simulator::SetScheduler (probed);
+        }
+      else if (scheduler != "ns3::MapScheduler")
+        {
+          Simulator::SetScheduler (ObjectFactory (scheduler));
+        }
+
+      NS_LOG_INFO ("Run Simulation.");
+      Simulator::Stop (Seconds (stopTime));
+      std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now ();
+      Simulator::Run ();
+      if (reportEvents)
+        {
+          double wall = std::chrono::duration<double> (std::chrono::steady_clock::now () - runStart).count ();
+          std::cout << "Executed " << Simulator::GetEventCount () << " events in " << wall
+                    << " s (" << Simulator::GetEventCount () / wall << " events/s)" << std::endl;
+        }
+      roleTracer.Flush ();
+      traceFile.Close ();
+      backboneEnergy.Close ();
+      metrics["echoReplies"] = state->echoReplies;
+      metrics["simSeconds"] = Simulator::Now ().GetSeconds ();
+    }, runs, RngSeedManager::GetRun ());
+
+  if (runs > 1)
+    {
+      ScenarioRunner::PrintSummary (std::cout, results);
+    }
 }
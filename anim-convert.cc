@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Convert a binary animation trace, recorded by running a scenario with
+// --animTrace, into a NetAnim XML file.
+//
+//   ./anim-convert --input=mixed-wireless.anim --output=mixed-wireless.xml
+//
+// The records are in simulation time order, so the trace is cut into
+// consecutive chunks of records, i.e. consecutive slices of simulation
+// time.  Each round reads one chunk per thread, formats the chunks in
+// parallel and appends them to the output in order; only one round of
+// records is in memory at a time.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ns3/core-module.h"
+
+#include "anim-writer.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("AnimConvert");
+
+//
+// Format records [first, last) into a string of NetAnim XML elements.
+//
+static void
+FormatChunk (const AnimRecord *first, const AnimRecord *last, std::string *out)
+{
+  std::ostringstream os;
+  for (const AnimRecord *r = first; r != last; ++r)
+    {
+      AnimWriter::WriteXml (os, *r);
+    }
+  *out = os.str ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string input = "";
+  std::string output = "";
+  uint32_t threads = std::thread::hardware_concurrency ();
+  uint32_t chunkRecords = 1 << 18;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("input", "binary animation trace to read", input);
+  cmd.AddValue ("output", "NetAnim XML file to write", output);
+  cmd.AddValue ("threads", "number of formatting threads", threads);
+  cmd.AddValue ("chunkRecords", "records formatted by one thread at a time", chunkRecords);
+  cmd.Parse (argc, argv);
+
+  if (input.empty () || output.empty ())
+    {
+      std::cout << "Use --input=<trace> --output=<xml>" << std::endl;
+      exit (1);
+    }
+  if (threads == 0)
+    {
+      threads = 1;
+    }
+
+  std::ifstream in (input.c_str (), std::ios::in | std::ios::binary);
+  NS_ABORT_MSG_IF (!in.is_open (), "Cannot open " << input);
+  AnimFileHeader header;
+  in.read (reinterpret_cast<char *> (&header), sizeof (header));
+  NS_ABORT_MSG_IF (!in || std::memcmp (header.magic, "NS3ANIM", sizeof header.magic) != 0,
+                   input << " is not a binary animation trace");
+  NS_ABORT_MSG_IF (header.version != 1 || header.recordSize != sizeof (AnimRecord),
+                   input << " was written by an incompatible AnimWriter");
+
+  std::ofstream out (output.c_str ());
+  NS_ABORT_MSG_IF (!out.is_open (), "Cannot open " << output);
+  AnimWriter::WriteXmlHeader (out);
+
+  std::vector<AnimRecord> records (static_cast<size_t> (threads) * chunkRecords);
+  std::vector<std::string> text (threads);
+  uint64_t total = 0;
+  while (in)
+    {
+      in.read (reinterpret_cast<char *> (&records[0]), records.size () * sizeof (AnimRecord));
+      size_t n = in.gcount () / sizeof (AnimRecord);
+      if (n == 0)
+        {
+          break;
+        }
+      std::vector<std::thread> workers;
+      for (uint32_t t = 0; t < threads; ++t)
+        {
+          size_t first = std::min (n, static_cast<size_t> (t) * chunkRecords);
+          size_t last = std::min (n, first + chunkRecords);
+          text[t].clear ();
+          if (first < last)
+            {
+              workers.push_back (std::thread (&FormatChunk, &records[first], &records[0] + last, &text[t]));
+            }
+        }
+      for (size_t t = 0; t < workers.size (); ++t)
+        {
+          workers[t].join ();
+        }
+      for (uint32_t t = 0; t < threads; ++t)
+        {
+          out << text[t];
+        }
+      total += n;
+    }
+
+  AnimWriter::WriteXmlFooter (out);
+  NS_LOG_INFO ("Converted " << total << " records from " << input << " into " << output);
+  return 0;
+}
@@ -0,0 +1,356 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef ANIM_WRITER_H
+#define ANIM_WRITER_H
+
+//
+// A NetAnim writer that keeps XML formatting and file output off the
+// simulation thread.
+//
+// AnimationInterface formats and writes its XML from inside the trace
+// callbacks.  AnimWriter instead copies each event into a small fixed-size
+// record and pushes it onto a single-producer single-consumer ring; a
+// background thread pops the records, formats them and writes the file.
+// The ring has a fixed capacity, so memory stays bounded: if the writer
+// ever falls that far behind, the simulation thread waits for it rather
+// than dropping animation records.
+//
+// Only what NetAnim needs to replay the run is recorded: node positions
+// (initial and on every course change) and packet transmissions and
+// receptions at the MAC.
+//
+// With AnimWriter::BINARY the records are written out as they are, behind
+// a short AnimFileHeader, instead of being formatted.  That costs little
+// more than a plain run; anim-convert turns such a file into NetAnim XML
+// later, only for the runs somebody wants to look at.
+//
+
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/callback.h"
+#include "ns3/csma-net-device.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/wifi-net-device.h"
+
+namespace ns3 {
+
+/**
+ * \brief One animation event, as handed from the simulation thread to the
+ * serializer.
+ */
+struct AnimRecord
+{
+  /// Kind of animation event.
+  enum Type
+  {
+    NODE = 0,     //!< initial node position
+    POSITION = 1, //!< node position update
+    TX = 2,       //!< packet sent by node
+    RX = 3        //!< packet received by node
+  };
+
+  int64_t time;   //!< simulation time, in nanoseconds
+  uint64_t uid;   //!< packet uid (TX and RX only)
+  double x;       //!< x coordinate (NODE and POSITION only)
+  double y;       //!< y coordinate (NODE and POSITION only)
+  uint32_t node;  //!< node id
+  uint32_t type;  //!< one of Type
+};
+
+/**
+ * \brief Start of a binary animation trace; AnimRecords follow.
+ */
+struct AnimFileHeader
+{
+  char magic[8];       //!< "NS3ANIM" and a terminating nul
+  uint32_t version;    //!< format version, currently 1
+  uint32_t recordSize; //!< sizeof (AnimRecord) of the writer
+};
+
+/**
+ * \brief NetAnim XML writer fed through a bounded lock-free queue.
+ *
+ * Open () the output, Install () the nodes to animate, run the
+ * simulation, then Close () to drain the queue and finish the file.
+ */
+class AnimWriter
+{
+public:
+  /// Number of records the queue can hold; a power of two.
+  static const uint32_t QUEUE_SIZE = 1 << 16;
+
+  /// Output format.
+  enum Format
+  {
+    XML,    //!< NetAnim XML, ready to load
+    BINARY  //!< raw AnimRecords, for anim-convert
+  };
+
+  AnimWriter ()
+    : m_queue (QUEUE_SIZE),
+      m_head (0),
+      m_tail (0),
+      m_stop (false),
+      m_stalls (0),
+      m_format (XML)
+  {
+  }
+
+  ~AnimWriter ()
+  {
+    Close ();
+  }
+
+  /**
+   * \brief Open the output and start the serializer thread.
+   * \param filename the file to write
+   * \param format NetAnim XML, or a binary trace for anim-convert
+   */
+  void Open (std::string filename, Format format = XML)
+  {
+    m_format = format;
+    m_file.open (filename.c_str (), std::ios::out | std::ios::binary);
+    NS_ABORT_MSG_IF (!m_file.is_open (), "Cannot open animation file " << filename);
+    if (m_format == BINARY)
+      {
+        AnimFileHeader header;
+        std::memset (&header, 0, sizeof (header));
+        std::strcpy (header.magic, "NS3ANIM");
+        header.version = 1;
+        header.recordSize = sizeof (AnimRecord);
+        m_file.write (reinterpret_cast<const char *> (&header), sizeof (header));
+      }
+    else
+      {
+        WriteXmlHeader (m_file);
+      }
+    m_thread = std::thread (&AnimWriter::Serialize, this);
+  }
+
+  /**
+   * \brief Record the nodes' initial positions and follow their movements
+   * and MAC-level packet events.
+   * \param nodes the nodes to animate
+   */
+  void Install (NodeContainer nodes)
+  {
+    for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+      {
+        Ptr<Node> node = *i;
+        Ptr<MobilityModel> mobility = node->GetObject<MobilityModel> ();
+        Vector position = mobility != 0 ? mobility->GetPosition () : Vector ();
+        Push (AnimRecord::NODE, node->GetId (), 0, position.x, position.y);
+        if (mobility != 0)
+          {
+            mobility->TraceConnectWithoutContext ("CourseChange",
+                                                  MakeBoundCallback (&AnimWriter::CourseChange, this, node->GetId ()));
+          }
+        for (uint32_t d = 0; d < node->GetNDevices (); ++d)
+          {
+            Ptr<Object> source;
+            Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice> (node->GetDevice (d));
+            if (wifi != 0)
+              {
+                source = wifi->GetMac ();
+              }
+            else if (DynamicCast<CsmaNetDevice> (node->GetDevice (d)) != 0)
+              {
+                source = node->GetDevice (d);
+              }
+            if (source != 0)
+              {
+                source->TraceConnectWithoutContext ("MacTx", MakeBoundCallback (&AnimWriter::Tx, this, node->GetId ()));
+                source->TraceConnectWithoutContext ("MacRx", MakeBoundCallback (&AnimWriter::Rx, this, node->GetId ()));
+              }
+          }
+      }
+  }
+
+  /**
+   * \brief Drain the queue, finish the XML document and stop the serializer.
+   */
+  void Close ()
+  {
+    if (!m_thread.joinable ())
+      {
+        return;
+      }
+    m_stop.store (true, std::memory_order_release);
+    m_thread.join ();
+    if (m_format == XML)
+      {
+        WriteXmlFooter (m_file);
+      }
+    m_file.close ();
+  }
+
+  /**
+   * \return how many times the simulation thread found the queue full
+   */
+  uint64_t GetStalls () const
+  {
+    return m_stalls;
+  }
+
+  /// Write the opening element of a NetAnim XML document.
+  static void WriteXmlHeader (std::ostream &os)
+  {
+    os << "<anim ver=\"netanim-3.108\" filetype=\"animation\" >\n";
+  }
+
+  /// Write the closing element of a NetAnim XML document.
+  static void WriteXmlFooter (std::ostream &os)
+  {
+    os << "</anim>\n";
+  }
+
+  /// Format one record as the NetAnim XML element that describes it.
+  static void WriteXml (std::ostream &os, const AnimRecord &r)
+  {
+    double t = r.time / 1e9;
+    switch (r.type)
+      {
+      case AnimRecord::NODE:
+        os << "<node id=\"" << r.node << "\" sysId=\"0\" locX=\"" << r.x
+           << "\" locY=\"" << r.y << "\" />\n";
+        break;
+      case AnimRecord::POSITION:
+        os << "<nu p=\"p\" t=\"" << t << "\" id=\"" << r.node << "\" x=\"" << r.x
+           << "\" y=\"" << r.y << "\" />\n";
+        break;
+      case AnimRecord::TX:
+        os << "<wpr uId=\"" << r.uid << "\" fId=\"" << r.node << "\" fbTx=\"" << t
+           << "\" lbTx=\"" << t << "\" />\n";
+        break;
+      case AnimRecord::RX:
+        os << "<wpr uId=\"" << r.uid << "\" tId=\"" << r.node << "\" fbRx=\"" << t
+           << "\" lbRx=\"" << t << "\" />\n";
+        break;
+      }
+  }
+
+private:
+  static void CourseChange (AnimWriter *writer, uint32_t node, Ptr<const MobilityModel> model)
+  {
+    Vector position = model->GetPosition ();
+    writer->Push (AnimRecord::POSITION, node, 0, position.x, position.y);
+  }
+
+  static void Tx (AnimWriter *writer, uint32_t node, Ptr<const Packet> p)
+  {
+    writer->Push (AnimRecord::TX, node, p->GetUid (), 0, 0);
+  }
+
+  static void Rx (AnimWriter *writer, uint32_t node, Ptr<const Packet> p)
+  {
+    writer->Push (AnimRecord::RX, node, p->GetUid (), 0, 0);
+  }
+
+  /// Called on the simulation thread only.
+  void Push (uint32_t type, uint32_t node, uint64_t uid, double x, double y)
+  {
+    uint64_t tail = m_tail.load (std::memory_order_relaxed);
+    if (tail - m_head.load (std::memory_order_acquire) == QUEUE_SIZE)
+      {
+        m_stalls++;
+        while (tail - m_head.load (std::memory_order_acquire) == QUEUE_SIZE)
+          {
+            std::this_thread::yield ();
+          }
+      }
+    AnimRecord &r = m_queue[tail & (QUEUE_SIZE - 1)];
+    r.time = Simulator::Now ().GetNanoSeconds ();
+    r.uid = uid;
+    r.x = x;
+    r.y = y;
+    r.node = node;
+    r.type = type;
+    m_tail.store (tail + 1, std::memory_order_release);
+  }
+
+  /// Body of the serializer thread.
+  void Serialize ()
+  {
+    while (true)
+      {
+        uint64_t head = m_head.load (std::memory_order_relaxed);
+        uint64_t tail = m_tail.load (std::memory_order_acquire);
+        if (head == tail)
+          {
+            if (m_stop.load (std::memory_order_acquire)
+                && m_tail.load (std::memory_order_acquire) == head)
+              {
+                break;
+              }
+            std::this_thread::sleep_for (std::chrono::microseconds (200));
+            continue;
+          }
+        if (m_format == BINARY)
+          {
+            // Write the records straight from the ring, one contiguous
+            // stretch at a time
+            while (head != tail)
+              {
+                uint64_t first = head & (QUEUE_SIZE - 1);
+                uint64_t n = std::min<uint64_t> (tail - head, QUEUE_SIZE - first);
+                m_file.write (reinterpret_cast<const char *> (&m_queue[first]),
+                              n * sizeof (AnimRecord));
+                head += n;
+                m_head.store (head, std::memory_order_release);
+              }
+            continue;
+          }
+        for (; head != tail; ++head)
+          {
+            WriteXml (m_file, m_queue[head & (QUEUE_SIZE - 1)]);
+            if ((head & 1023) == 1023)
+              {
+                // Hand slots back to the producer as we go
+                m_head.store (head + 1, std::memory_order_release);
+              }
+          }
+        m_head.store (head, std::memory_order_release);
+      }
+  }
+
+  std::vector<AnimRecord> m_queue;  //!< ring of records, QUEUE_SIZE long
+  std::atomic<uint64_t> m_head;     //!< next record to serialize
+  std::atomic<uint64_t> m_tail;     //!< next free slot
+  std::atomic<bool> m_stop;         //!< set by Close () to end the thread
+  uint64_t m_stalls;                //!< pushes that found the queue full
+  Format m_format;                  //!< output format
+  std::ofstream m_file;             //!< output, used by the thread only
+  std::thread m_thread;             //!< serializer thread
+};
+
+} // namespace ns3
+
+#endif /* ANIM_WRITER_H */
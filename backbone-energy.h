@@ -0,0 +1,156 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BACKBONE_ENERGY_H
+#define BACKBONE_ENERGY_H
+
+//
+// Battery model for the mobile backbone routers.
+//
+// Every router gets a BasicEnergySource, and every wifi radio on it (the
+// ad hoc backbone radio and the access point of its infrastructure net) a
+// WifiRadioEnergyModel drawing from that source.  The radio model already
+// charges the source whenever the PHY changes state, integrating the
+// current of the state that just ended; the only periodic work left is the
+// source's own PeriodicEnergyUpdateInterval event, which is stretched to
+// the length of the run so that it adds at most one event per node.
+//
+// The remaining energy of each source is logged as "time node joules"
+// lines, but only when it has dropped by at least the given resolution
+// since the last line for that node, plus a final line per node.
+//
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/basic-energy-source.h"
+#include "ns3/basic-energy-source-helper.h"
+#include "ns3/callback.h"
+#include "ns3/energy-source-container.h"
+#include "ns3/node-container.h"
+#include "ns3/simulator.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-radio-energy-model-helper.h"
+
+#include "tick-time.h"
+
+namespace ns3 {
+
+/**
+ * \brief Installs batteries on backbone routers and logs how they drain.
+ */
+class BackboneEnergy
+{
+public:
+  BackboneEnergy ()
+    : m_resolution (0)
+  {
+  }
+
+  /**
+   * \brief Install an energy source and radio energy models on the routers.
+   * \param routers the nodes to power from a battery
+   * \param initialEnergy battery capacity, in joules
+   * \param runTime length of the run, used as the source update interval
+   */
+  void Install (NodeContainer routers, double initialEnergy, Time runTime)
+  {
+    BasicEnergySourceHelper sourceHelper;
+    sourceHelper.Set ("BasicEnergySourceInitialEnergyJ", DoubleValue (initialEnergy));
+    sourceHelper.Set ("PeriodicEnergyUpdateInterval", TimeValue (runTime));
+    m_sources = sourceHelper.Install (routers);
+
+    WifiRadioEnergyModelHelper radioHelper;
+    for (uint32_t i = 0; i < routers.GetN (); ++i)
+      {
+        Ptr<Node> node = routers.Get (i);
+        Ptr<EnergySource> source = m_sources.Get (i);
+        for (uint32_t d = 0; d < node->GetNDevices (); ++d)
+          {
+            if (DynamicCast<WifiNetDevice> (node->GetDevice (d)) != 0)
+              {
+                radioHelper.Install (node->GetDevice (d), source);
+              }
+          }
+      }
+  }
+
+  /**
+   * \brief Log the remaining energy of every installed source.
+   * \param filename where the "time node joules" lines are written
+   * \param resolution smallest drop, in joules, worth a new line
+   */
+  void EnableLog (std::string filename, double resolution)
+  {
+    m_log.open (filename.c_str ());
+    NS_ABORT_MSG_IF (!m_log.is_open (), "Cannot open energy log " << filename);
+    m_resolution = resolution;
+    m_logged.resize (m_sources.GetN ());
+    for (uint32_t i = 0; i < m_sources.GetN (); ++i)
+      {
+        Ptr<EnergySource> source = m_sources.Get (i);
+        m_logged[i] = source->GetInitialEnergy ();
+        m_log << 0 << " " << source->GetNode ()->GetId () << " " << m_logged[i] << "\n";
+        source->TraceConnectWithoutContext ("RemainingEnergy",
+                                            MakeBoundCallback (&BackboneEnergy::RemainingEnergy, this, i));
+      }
+  }
+
+  /**
+   * \brief Write the final energy of every source and close the log.
+   *
+   * Call after Simulator::Run (), before Simulator::Destroy ().
+   */
+  void Close ()
+  {
+    if (!m_log.is_open ())
+      {
+        return;
+      }
+    double now = TickSeconds (Simulator::Now ());
+    for (uint32_t i = 0; i < m_sources.GetN (); ++i)
+      {
+        Ptr<EnergySource> source = m_sources.Get (i);
+        m_log << now << " " << source->GetNode ()->GetId () << " "
+              << source->GetRemainingEnergy () << "\n";
+      }
+    m_log.close ();
+  }
+
+private:
+  static void RemainingEnergy (BackboneEnergy *energy, uint32_t index, double, double remaining)
+  {
+    if (energy->m_logged[index] - remaining >= energy->m_resolution)
+      {
+        energy->m_logged[index] = remaining;
+        energy->m_log << TickSeconds (Simulator::Now ()) << " "
+                      << energy->m_sources.Get (index)->GetNode ()->GetId () << " "
+                      << remaining << "\n";
+      }
+  }
+
+  EnergySourceContainer m_sources; //!< one battery per router
+  std::ofstream m_log;             //!< remaining energy log
+  double m_resolution;             //!< smallest logged drop, in joules
+  std::vector<double> m_logged;    //!< last logged energy per source
+};
+
+} // namespace ns3
+
+#endif /* BACKBONE_ENERGY_H */
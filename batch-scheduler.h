@@ -0,0 +1,139 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BATCH_SCHEDULER_H
+#define BATCH_SCHEDULER_H
+
+//
+// An event scheduler that keeps events of the same timestamp together.
+//
+// A broadcast on a wifi channel schedules one receive event per receiver,
+// and receivers at similar distances get identical timestamps.  The
+// MapScheduler keeps one tree node per event; BatchScheduler keeps one
+// tree node per distinct timestamp, holding that timestamp's events in a
+// vector.  Inserting into an existing timestamp is a tree lookup and an
+// append, and taking events out of a batch touches the tree only when the
+// batch is used up.
+//
+// The order of execution is exactly that of the other schedulers: by
+// timestamp, then by uid.  Uids grow with every Schedule (), so appending
+// keeps each batch in uid order.
+//
+
+#include <map>
+#include <vector>
+
+#include "ns3/assert.h"
+#include "ns3/scheduler.h"
+
+namespace ns3 {
+
+/**
+ * \brief Scheduler with one map entry per distinct timestamp.
+ */
+class BatchScheduler : public Scheduler
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::BatchScheduler")
+      .SetParent<Scheduler> ()
+      .SetGroupName ("Core")
+      .AddConstructor<BatchScheduler> ()
+    ;
+    return tid;
+  }
+
+  // Inherited from Scheduler
+  void Insert (const Event &ev)
+  {
+    Batch &batch = m_batches[ev.key.m_ts];
+    NS_ASSERT (batch.events.size () == batch.next || batch.events.back ().key.m_uid < ev.key.m_uid);
+    batch.events.push_back (ev);
+  }
+
+  bool IsEmpty (void) const
+  {
+    return m_batches.empty ();
+  }
+
+  Event PeekNext (void) const
+  {
+    NS_ASSERT (!IsEmpty ());
+    const Batch &batch = m_batches.begin ()->second;
+    return batch.events[batch.next];
+  }
+
+  Event RemoveNext (void)
+  {
+    NS_ASSERT (!IsEmpty ());
+    std::map<uint64_t, Batch>::iterator first = m_batches.begin ();
+    Event ev = first->second.events[first->second.next++];
+    if (first->second.next == first->second.events.size ())
+      {
+        m_batches.erase (first);
+      }
+    return ev;
+  }
+
+  void Remove (const Event &ev)
+  {
+    std::map<uint64_t, Batch>::iterator it = m_batches.find (ev.key.m_ts);
+    NS_ASSERT (it != m_batches.end ());
+    std::vector<Event> &events = it->second.events;
+    bool found = false;
+    for (size_t i = it->second.next; i < events.size (); ++i)
+      {
+        if (events[i].key.m_uid == ev.key.m_uid)
+          {
+            events.erase (events.begin () + i);
+            found = true;
+            break;
+          }
+      }
+    NS_ASSERT_MSG (found, "Event to remove is not in the scheduler");
+    if (it->second.next == events.size ())
+      {
+        m_batches.erase (it);
+      }
+  }
+
+private:
+  /// The events of one timestamp, in uid order.
+  struct Batch
+  {
+    Batch ()
+      : next (0)
+    {
+    }
+
+    std::vector<Event> events; //!< events, executed ones included
+    size_t next;               //!< first event not yet removed
+  };
+
+  std::map<uint64_t, Batch> m_batches; //!< batches by timestamp
+};
+
+NS_OBJECT_ENSURE_REGISTERED (BatchScheduler);
+
+} // namespace ns3
+
+#endif /* BATCH_SCHEDULER_H */
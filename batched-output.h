@@ -0,0 +1,350 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BATCHED_OUTPUT_H
+#define BATCHED_OUTPUT_H
+
+//
+// A trace file written in large batches, off the simulation thread.
+//
+// The ascii trace sinks end every line with std::endl, i.e. with a flush,
+// so an ofstream behind them does one write () per traced packet.
+// BatchedOutput gives the tracers an ostream whose buffer ignores those
+// flushes: text accumulates in page-aligned buffers of BUFFER_SIZE bytes,
+// and each full buffer is handed over to be written at its file offset
+// while the simulation fills the next one.  Only when all BUFFERS buffers
+// are still in flight does the simulation thread wait.
+//
+// Buffers are written by a background thread with pwrite (), or, when
+// built with -DNS3SIM_USE_IO_URING and linked with liburing, submitted to
+// an io_uring from the simulation thread itself.
+//
+// Since flushes are ignored, nothing is guaranteed to be on disk before
+// Close ().  Use it with OutputStreamWrapper:
+//
+//   BatchedOutput out;
+//   out.Open ("adhoc-network.tr");
+//   Ptr<OutputStreamWrapper> stream = Create<OutputStreamWrapper> (out.GetStream ());
+//   ...
+//   Simulator::Run ();
+//   out.Close ();
+//
+
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined (NS3SIM_USE_IO_URING) && defined (__has_include)
+#if __has_include (<liburing.h>)
+#include <liburing.h>
+#define NS3SIM_HAVE_IO_URING 1
+#endif
+#endif
+
+#include "ns3/abort.h"
+
+namespace ns3 {
+
+/**
+ * \brief Output file written in large aligned batches by a background
+ * writer.
+ */
+class BatchedOutput
+{
+public:
+  /// Size of each buffer, in bytes.
+  static const size_t BUFFER_SIZE = 1 << 20;
+  /// Number of buffers; all but one can be in flight at a time.
+  static const uint32_t BUFFERS = 8;
+  /// Alignment of the buffers.
+  static const size_t ALIGNMENT = 4096;
+
+  BatchedOutput ()
+    : m_fd (-1),
+      m_offset (0),
+      m_buf (this),
+      m_stream (&m_buf),
+      m_stop (false)
+  {
+  }
+
+  ~BatchedOutput ()
+  {
+    Close ();
+  }
+
+  /**
+   * \brief Create the file and start the writer.
+   * \param filename the file to write
+   */
+  void Open (std::string filename)
+  {
+    m_fd = open (filename.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    NS_ABORT_MSG_IF (m_fd < 0, "Cannot open " << filename << ": " << std::strerror (errno));
+    m_filename = filename;
+    for (uint32_t i = 0; i < BUFFERS; ++i)
+      {
+        void *buffer = 0;
+        NS_ABORT_MSG_IF (posix_memalign (&buffer, ALIGNMENT, BUFFER_SIZE) != 0, "Out of memory");
+        m_buffers.push_back (static_cast<char *> (buffer));
+        m_free.push_back (i);
+      }
+#ifdef NS3SIM_HAVE_IO_URING
+    int err = io_uring_queue_init (BUFFERS, &m_ring, 0);
+    NS_ABORT_MSG_IF (err < 0, "Cannot set up io_uring: " << std::strerror (-err));
+#else
+    m_thread = std::thread (&BatchedOutput::Write, this);
+#endif
+    Next ();
+  }
+
+  /**
+   * \return the stream to write to; it stays valid until the object is
+   * destroyed
+   */
+  std::ostream *GetStream ()
+  {
+    return &m_stream;
+  }
+
+  /**
+   * \brief Write out everything still buffered and close the file.
+   */
+  void Close ()
+  {
+    if (m_fd < 0)
+      {
+        return;
+      }
+    Submit ();
+#ifdef NS3SIM_HAVE_IO_URING
+    while (m_inFlight > 0)
+      {
+        Reap ();
+      }
+    io_uring_queue_exit (&m_ring);
+#else
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_all ();
+    m_thread.join ();
+#endif
+    close (m_fd);
+    m_fd = -1;
+    for (size_t i = 0; i < m_buffers.size (); ++i)
+      {
+        free (m_buffers[i]);
+      }
+    m_buffers.clear ();
+    m_free.clear ();
+    m_buf.setp (0, 0);
+  }
+
+private:
+  /// Stream buffer over the current batch; flushes do nothing.
+  class Buffer : public std::streambuf
+  {
+  public:
+    Buffer (BatchedOutput *owner)
+      : m_owner (owner)
+    {
+    }
+
+    using std::streambuf::setp;
+
+    /// \return the number of bytes written to the current buffer
+    size_t Used (void) const
+    {
+      return pptr () - pbase ();
+    }
+
+  protected:
+    int_type overflow (int_type c)
+    {
+      NS_ABORT_MSG_IF (pbase () == 0, "BatchedOutput written before Open () or after Close ()");
+      m_owner->Submit ();
+      m_owner->Next ();
+      if (!traits_type::eq_int_type (c, traits_type::eof ()))
+        {
+          *pptr () = traits_type::to_char_type (c);
+          pbump (1);
+        }
+      return traits_type::not_eof (c);
+    }
+
+    int sync ()
+    {
+      return 0;
+    }
+
+  private:
+    BatchedOutput *m_owner; //!< the output owning this buffer
+  };
+
+  /// A buffer handed to the writer.
+  struct Pending
+  {
+    uint32_t buffer; //!< index into m_buffers
+    size_t length;   //!< bytes to write
+    off_t offset;    //!< where in the file
+  };
+
+  /// Hand the current buffer, if not empty, over to be written.
+  void Submit ()
+  {
+    size_t length = m_buf.Used ();
+    if (length == 0)
+      {
+        return;
+      }
+    Pending p;
+    p.buffer = m_current;
+    p.length = length;
+    p.offset = m_offset;
+    m_offset += length;
+    m_buf.setp (0, 0);
+#ifdef NS3SIM_HAVE_IO_URING
+    m_pending[p.buffer] = p;
+    struct io_uring_sqe *sqe = io_uring_get_sqe (&m_ring);
+    io_uring_prep_write (sqe, m_fd, m_buffers[p.buffer], p.length, p.offset);
+    io_uring_sqe_set_data (sqe, &m_pending[p.buffer]);
+    io_uring_submit (&m_ring);
+    m_inFlight++;
+#else
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_queue.push_back (p);
+    }
+    m_cv.notify_all ();
+#endif
+  }
+
+  /// Make a free buffer current, waiting for one if necessary.
+  void Next ()
+  {
+#ifdef NS3SIM_HAVE_IO_URING
+    while (m_free.empty ())
+      {
+        Reap ();
+      }
+    m_current = m_free.back ();
+    m_free.pop_back ();
+#else
+    std::unique_lock<std::mutex> lock (m_mutex);
+    m_cv.wait (lock, [this] () { return !m_free.empty (); });
+    m_current = m_free.back ();
+    m_free.pop_back ();
+#endif
+    m_buf.setp (m_buffers[m_current], m_buffers[m_current] + BUFFER_SIZE);
+  }
+
+  /// Write a whole buffer with pwrite (), however many calls it takes.
+  void WriteAll (const char *data, size_t length, off_t offset)
+  {
+    while (length > 0)
+      {
+        ssize_t n = pwrite (m_fd, data, length, offset);
+        if (n < 0 && errno == EINTR)
+          {
+            continue;
+          }
+        NS_ABORT_MSG_IF (n <= 0, "Cannot write " << m_filename << ": " << std::strerror (errno));
+        data += n;
+        length -= n;
+        offset += n;
+      }
+  }
+
+#ifdef NS3SIM_HAVE_IO_URING
+  /// Wait for one write to complete and free its buffer.
+  void Reap ()
+  {
+    struct io_uring_cqe *cqe;
+    int err = io_uring_wait_cqe (&m_ring, &cqe);
+    NS_ABORT_MSG_IF (err < 0, "io_uring wait failed: " << std::strerror (-err));
+    Pending *p = static_cast<Pending *> (io_uring_cqe_get_data (cqe));
+    int res = cqe->res;
+    io_uring_cqe_seen (&m_ring, cqe);
+    NS_ABORT_MSG_IF (res < 0, "Cannot write " << m_filename << ": " << std::strerror (-res));
+    if (static_cast<size_t> (res) < p->length)
+      {
+        // Short write: finish it synchronously
+        WriteAll (m_buffers[p->buffer] + res, p->length - res, p->offset + res);
+      }
+    m_free.push_back (p->buffer);
+    m_inFlight--;
+  }
+#else
+  /// Body of the writer thread.
+  void Write ()
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    while (true)
+      {
+        m_cv.wait (lock, [this] () { return m_stop || !m_queue.empty (); });
+        if (m_queue.empty ())
+          {
+            break;
+          }
+        Pending p = m_queue.front ();
+        m_queue.pop_front ();
+        lock.unlock ();
+        WriteAll (m_buffers[p.buffer], p.length, p.offset);
+        lock.lock ();
+        m_free.push_back (p.buffer);
+        m_cv.notify_all ();
+      }
+  }
+#endif
+
+  int m_fd;                        //!< output file
+  std::string m_filename;          //!< output file name, for errors
+  off_t m_offset;                  //!< file offset of the current buffer
+  Buffer m_buf;                    //!< stream buffer over the current buffer
+  std::ostream m_stream;           //!< stream handed to the tracers
+  std::vector<char *> m_buffers;   //!< all buffers, BUFFER_SIZE each
+  std::vector<uint32_t> m_free;    //!< buffers ready to be filled
+  uint32_t m_current;              //!< buffer being filled
+#ifdef NS3SIM_HAVE_IO_URING
+  struct io_uring m_ring;          //!< submission and completion queues
+  Pending m_pending[BUFFERS];      //!< write in flight per buffer
+  uint32_t m_inFlight = 0;         //!< submitted, not yet completed writes
+#else
+  std::mutex m_mutex;              //!< protects m_queue, m_free and m_stop
+  std::condition_variable m_cv;    //!< signals queued and freed buffers
+  std::deque<Pending> m_queue;     //!< buffers waiting to be written
+  std::thread m_thread;            //!< writer thread
+#endif
+  bool m_stop;                     //!< set by Close () to end the thread
+};
+
+} // namespace ns3
+
+#endif /* BATCHED_OUTPUT_H */
@@ -0,0 +1,63 @@
+#!/bin/sh
+#
+# Compare the event rate of the simulations across build variants.
+#
+# Usage: ./bench-events.sh [repeats] [variant...]
+#
+# adhoc-network and mixed-wired-wireless of each variant (see
+# build-variants.sh; default static and pgo) run `repeats` times (default
+# 3) with --reportEvents, and the best events/s of the repeats is printed.
+# The arguments of the runs can be changed through BENCH_ADHOC and
+# BENCH_MIXED; use runs that differ from the PGO training runs.
+#
+
+set -e
+
+REPEATS=${1:-3}
+[ $# -gt 0 ] && shift
+OUT_DIR=${OUT_DIR:-$(pwd)/variants}
+BENCH_ADHOC=${BENCH_ADHOC:-"--stopTime=60 --backboneNodes=30 --traceMode=aggregate"}
+BENCH_MIXED=${BENCH_MIXED:-"--stopTime=60 --backboneNodes=30 --traceMode=aggregate --pcap=false"}
+if [ $# -eq 0 ]; then
+  set -- static pgo
+fi
+
+# best_rate PROGRAM VARIANT ARGS
+best_rate ()
+{
+  best=0
+  run_dir=$(mktemp -d)
+  i=0
+  while [ $i -lt "$REPEATS" ]; do
+    # shellcheck disable=SC2086
+    rate=$(cd "$run_dir" && LD_LIBRARY_PATH="$OUT_DIR/$2/lib" "$OUT_DIR/$2/$1" $3 --reportEvents \
+             | sed -n 's/^Executed .*(\([0-9.e+]*\) events\/s)$/\1/p')
+    best=$(echo "$rate $best" | awk '{ print ($1 > $2) ? $1 : $2 }')
+    i=$((i + 1))
+  done
+  rm -rf "$run_dir"
+  echo "$best"
+}
+
+printf "%-22s" program
+for variant in "$@"; do
+  printf " %16s" "$variant(ev/s)"
+done
+echo
+
+for program in adhoc-network mixed-wired-wireless; do
+  if [ "$program" = adhoc-network ]; then
+    args=$BENCH_ADHOC
+  else
+    args=$BENCH_MIXED
+  fi
+  printf "%-22s" "$program"
+  for variant in "$@"; do
+    if [ ! -x "$OUT_DIR/$variant/$program" ]; then
+      printf " %16s" -
+      continue
+    fi
+    printf " %16.0f" "$(best_rate "$program" "$variant" "$args")"
+  done
+  echo
+done
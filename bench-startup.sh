@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Compare the startup time of the scenario programs across build variants.
+#
+# Usage: ./bench-startup.sh [runs] [variant...]
+#
+# Each program of each variant (see build-variants.sh) is launched `runs`
+# times (default 100) with --PrintHelp, which loads the program and its
+# libraries, runs the static initializers, parses the command line and
+# exits before building any topology.  The mean wall time per launch is
+# printed in milliseconds.
+#
+
+set -e
+
+RUNS=${1:-100}
+[ $# -gt 0 ] && shift
+OUT_DIR=${OUT_DIR:-$(pwd)/variants}
+PROGRAMS="adhoc-network mixed-wired-wireless taller myfirst-anim"
+if [ $# -eq 0 ]; then
+  set -- shared static
+fi
+
+printf "%-22s" program
+for variant in "$@"; do
+  printf " %12s" "$variant(ms)"
+done
+echo
+
+for program in $PROGRAMS; do
+  printf "%-22s" "$program"
+  for variant in "$@"; do
+    binary="$OUT_DIR/$variant/$program"
+    if [ ! -x "$binary" ]; then
+      printf " %12s" -
+      continue
+    fi
+    # Warm the page cache first, so that every variant is measured hot
+    LD_LIBRARY_PATH="$OUT_DIR/$variant/lib" "$binary" --PrintHelp > /dev/null 2>&1 || true
+    start=$(date +%s%N)
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+      LD_LIBRARY_PATH="$OUT_DIR/$variant/lib" "$binary" --PrintHelp > /dev/null 2>&1 || true
+      i=$((i + 1))
+    done
+    end=$(date +%s%N)
+    printf " %12.3f" "$(echo "($end - $start) / $RUNS / 1000000" | bc -l)"
+  done
+  echo
+done
@@ -0,0 +1,112 @@
+#!/bin/sh
+#
+# Build the scenario programs of this directory in several variants, each
+# in its own output directory:
+#
+#   shared   the usual build: one shared library per ns-3 module
+#   static   ns-3 as static libraries linked into each program, built with
+#            link time optimization; one self-contained binary per program
+#   pgo      the static variant, optimized with the profile of training
+#            runs of adhoc-network and mixed-wired-wireless
+#
+# Usage: NS3_DIR=/path/to/ns-3 ./build-variants.sh [variant...]
+#
+# The programs and their headers are copied into $NS3_DIR/scratch, ns-3 is
+# configured by CMake in $NS3_DIR/cmake-cache-<variant>, and the binaries
+# are collected in $OUT_DIR/<variant> (default ./variants/<variant>).
+#
+# The pgo variant is built twice in the same cache directory, so that the
+# profile matches the objects: first instrumented (collected as pgo-gen),
+# then, after the training runs, with the profile.  The training runs can
+# be changed through TRAIN_ADHOC and TRAIN_MIXED; they should exercise the
+# paths the sweeps spend their time in.
+#
+
+set -e
+
+NS3_DIR=${NS3_DIR:?set NS3_DIR to an ns-3 source tree (3.36 or later)}
+OUT_DIR=${OUT_DIR:-$(pwd)/variants}
+JOBS=${JOBS:-$(nproc)}
+PROGRAMS="adhoc-network mixed-wired-wireless taller myfirst-anim replication-runner"
+SRC_DIR=$(cd "$(dirname "$0")" && pwd)
+PROFILE_DIR="$NS3_DIR/cmake-cache-pgo/profile"
+TRAIN_ADHOC=${TRAIN_ADHOC:-"--stopTime=30 --backboneNodes=20 --traceMode=aggregate"}
+TRAIN_MIXED=${TRAIN_MIXED:-"--stopTime=30 --backboneNodes=20 --traceMode=aggregate --pcap=false"}
+
+# CMake options shared by every variant
+COMMON="-DCMAKE_BUILD_TYPE=Release -DNS3_EXAMPLES=OFF -DNS3_TESTS=OFF -DNS3_NATIVE_OPTIMIZATIONS=OFF"
+
+variant_options ()
+{
+  case "$1" in
+    shared) echo "$COMMON" ;;
+    static|pgo) echo "$COMMON -DNS3_STATIC=ON -DNS3_LINK_TIME_OPTIMIZATION=ON" ;;
+    *) echo "unknown variant $1" >&2; exit 1 ;;
+  esac
+}
+
+# build VARIANT [OUTPUT-NAME [extra CMake options...]]
+build ()
+{
+  variant=$1
+  name=${2:-$variant}
+  [ $# -gt 1 ] && shift
+  shift
+  options="$(variant_options "$variant")"
+  cache="$NS3_DIR/cmake-cache-$variant"
+
+  cp "$SRC_DIR"/*.cc "$SRC_DIR"/*.h "$NS3_DIR/scratch/"
+  # shellcheck disable=SC2086
+  cmake -S "$NS3_DIR" -B "$cache" $options "$@"
+  for program in $PROGRAMS; do
+    cmake --build "$cache" -j "$JOBS" --target "scratch_$program"
+  done
+
+  # ns-3 writes every binary under $NS3_DIR/build, whatever the cache
+  # directory, so collect this variant's before the next one overwrites them
+  mkdir -p "$OUT_DIR/$name"
+  for program in $PROGRAMS; do
+    binary=$(ls -t "$NS3_DIR"/build/scratch/ns3*-"$program"-* | head -n 1)
+    cp "$binary" "$OUT_DIR/$name/$program"
+  done
+  # The shared variant needs the module libraries at run time
+  if [ "$variant" = shared ]; then
+    rm -rf "$OUT_DIR/$name/lib"
+    cp -r "$NS3_DIR/build/lib" "$OUT_DIR/$name/lib"
+  fi
+  echo "Built $name variant in $OUT_DIR/$name"
+}
+
+# Instrumented build, training runs, optimized build
+build_pgo ()
+{
+  rm -rf "$PROFILE_DIR"
+  mkdir -p "$PROFILE_DIR"
+  build pgo pgo-gen \
+    "-DCMAKE_CXX_FLAGS=-fprofile-generate -fprofile-dir=$PROFILE_DIR -fprofile-update=single" \
+    "-DCMAKE_EXE_LINKER_FLAGS=-fprofile-generate"
+
+  # The runs write their traces; keep them out of the way
+  train_dir=$(mktemp -d)
+  # shellcheck disable=SC2086
+  (cd "$train_dir" && "$OUT_DIR/pgo-gen/adhoc-network" $TRAIN_ADHOC > /dev/null)
+  # shellcheck disable=SC2086
+  (cd "$train_dir" && "$OUT_DIR/pgo-gen/mixed-wired-wireless" $TRAIN_MIXED > /dev/null)
+  rm -rf "$train_dir"
+
+  # Objects the training runs never reached have no profile; that is fine
+  build pgo pgo \
+    "-DCMAKE_CXX_FLAGS=-fprofile-use -fprofile-dir=$PROFILE_DIR -fprofile-partial-training -Wno-missing-profile" \
+    "-DCMAKE_EXE_LINKER_FLAGS="
+}
+
+if [ $# -eq 0 ]; then
+  set -- shared static
+fi
+for variant in "$@"; do
+  if [ "$variant" = pgo ]; then
+    build_pgo
+  else
+    build "$variant"
+  fi
+done
@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef FAST_EXIT_H
+#define FAST_EXIT_H
+
+//
+// Leave the process without tearing the simulation down.
+//
+// Simulator::Destroy () disposes every node, device, channel and protocol
+// one by one, and the Ptr graph between them is then released object by
+// object.  On large topologies that takes seconds, after all results have
+// already been written.  The operating system reclaims the memory of an
+// exiting process wholesale, so all that really has to happen at the end
+// is that buffered output reaches its files.
+//
+// FastExit runs the flush functions it was given, flushes the registered
+// trace streams and the C and C++ standard streams, and calls _exit ().
+// Nothing is disposed and no destructor runs, so every writer that keeps
+// its own buffer must be closed or registered beforehand.  Writers owned
+// by ns-3 that cannot be flushed from outside, such as the pcap files of
+// the trace helpers, are not covered: do not use it with pcap tracing on.
+//
+
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+#include "ns3/output-stream-wrapper.h"
+
+namespace ns3 {
+
+/**
+ * \brief Flushes the registered outputs and ends the process without
+ * disposing the simulation.
+ */
+class FastExit
+{
+public:
+  /**
+   * \brief Add a function to call before exiting.
+   * \param flush writes out whatever a writer still buffers
+   *
+   * Functions are called in the order they were added.
+   */
+  void Add (std::function<void (void)> flush)
+  {
+    m_flushers.push_back (flush);
+  }
+
+  /**
+   * \brief Add a trace stream to flush before exiting.
+   * \param stream the stream
+   */
+  void AddStream (Ptr<OutputStreamWrapper> stream)
+  {
+    m_streams.push_back (stream);
+  }
+
+  /**
+   * \brief Flush everything and end the process.
+   * \param status the exit status
+   */
+  void Exit (int status)
+  {
+    for (size_t i = 0; i < m_flushers.size (); ++i)
+      {
+        m_flushers[i] ();
+      }
+    for (size_t i = 0; i < m_streams.size (); ++i)
+      {
+        m_streams[i]->GetStream ()->flush ();
+      }
+    std::cout.flush ();
+    std::cerr.flush ();
+    std::fflush (0);
+    _exit (status);
+  }
+
+private:
+  std::vector<std::function<void (void)> > m_flushers; //!< called before exiting
+  std::vector<Ptr<OutputStreamWrapper> > m_streams;     //!< flushed before exiting
+};
+
+} // namespace ns3
+
+#endif /* FAST_EXIT_H */
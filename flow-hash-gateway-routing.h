@@ -0,0 +1,238 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef FLOW_HASH_GATEWAY_ROUTING_H
+#define FLOW_HASH_GATEWAY_ROUTING_H
+
+//
+// ECMP-style spreading of inter-cluster traffic over several gateways.
+//
+// Every node of a cluster runs this protocol ahead of OLSR in its
+// Ipv4ListRouting.  Traffic for the node's own cluster prefix is left to
+// OLSR.  Traffic for anywhere else is sent towards one of the cluster's
+// gateways, chosen by hashing the source address, destination address and
+// protocol number: every hop of the cluster computes the same hash, so a
+// flow sticks to one gateway while different flows spread over all of
+// them.  The route to the chosen gateway comes from OLSR; only the final
+// destination of the returned route is changed.
+//
+// A gateway hands outside traffic to the inter-cluster routing protocol
+// (the static routes over the head segment) only when the flow hashes to
+// the gateway itself.  Flows of other gateways that cross it on their
+// OLSR path are forwarded on towards their own gateway.
+//
+
+#include <vector>
+
+#include "ns3/hash.h"
+#include "ns3/ipv4.h"
+#include "ns3/ipv4-route.h"
+#include "ns3/ipv4-routing-protocol.h"
+#include "ns3/log.h"
+#include "ns3/output-stream-wrapper.h"
+
+namespace ns3 {
+
+/**
+ * \brief Sends inter-cluster flows through one of several gateways,
+ * chosen by flow hash.
+ */
+class FlowHashGatewayRouting : public Ipv4RoutingProtocol
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::FlowHashGatewayRouting")
+      .SetParent<Ipv4RoutingProtocol> ()
+      .SetGroupName ("Internet")
+      .AddConstructor<FlowHashGatewayRouting> ()
+    ;
+    return tid;
+  }
+
+  /**
+   * \brief Set the prefix of the cluster this node belongs to.
+   * \param network the cluster network address
+   * \param mask the cluster network mask
+   */
+  void SetCluster (Ipv4Address network, Ipv4Mask mask)
+  {
+    m_network = network;
+    m_mask = mask;
+  }
+
+  /**
+   * \brief Add a gateway of this node's cluster.
+   * \param gateway the gateway's address inside the cluster
+   */
+  void AddGateway (Ipv4Address gateway)
+  {
+    m_gateways.push_back (gateway);
+  }
+
+  /**
+   * \brief Set the protocols the routes come from.
+   * \param intraCluster the protocol routing inside the cluster (OLSR)
+   * \param interCluster the protocol routing between clusters; only set
+   * on gateways
+   */
+  void SetRoutingProtocols (Ptr<Ipv4RoutingProtocol> intraCluster,
+                            Ptr<Ipv4RoutingProtocol> interCluster)
+  {
+    m_intraCluster = intraCluster;
+    m_interCluster = interCluster;
+  }
+
+  // Inherited from Ipv4RoutingProtocol
+  Ptr<Ipv4Route> RouteOutput (Ptr<Packet> p, const Ipv4Header &header,
+                              Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
+  {
+    Ipv4Address destination = header.GetDestination ();
+    if (!IsOutside (destination))
+      {
+        sockerr = Socket::ERROR_NOROUTETOHOST;
+        return 0;
+      }
+    if (m_gateways.empty ())
+      {
+        sockerr = Socket::ERROR_NOROUTETOHOST;
+        return 0;
+      }
+    Ipv4Address source = header.GetSource ();
+    if (source == Ipv4Address ())
+      {
+        // Not chosen yet; use the address the cluster will see
+        source = m_ipv4->GetAddress (1, 0).GetLocal ();
+      }
+    Ipv4Address gateway = ChooseGateway (header, source);
+    if (IsThisGateway (gateway))
+      {
+        return m_interCluster->RouteOutput (p, header, oif, sockerr);
+      }
+    return RouteToGateway (p, header, gateway, oif, sockerr);
+  }
+
+  bool RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
+                   UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+                   LocalDeliverCallback lcb, ErrorCallback ecb)
+  {
+    if (!IsOutside (header.GetDestination ()) || m_gateways.empty ())
+      {
+        return false;
+      }
+    Ipv4Address gateway = ChooseGateway (header, header.GetSource ());
+    if (IsThisGateway (gateway))
+      {
+        return m_interCluster->RouteInput (p, header, idev, ucb, mcb, lcb, ecb);
+      }
+    Socket::SocketErrno sockerr;
+    Ptr<Ipv4Route> route = RouteToGateway (0, header, gateway, 0, sockerr);
+    if (route == 0)
+      {
+        return false;
+      }
+    ucb (route, p, header);
+    return true;
+  }
+
+  void NotifyInterfaceUp (uint32_t interface)
+  {
+  }
+
+  void NotifyInterfaceDown (uint32_t interface)
+  {
+  }
+
+  void NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
+  {
+  }
+
+  void NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
+  {
+  }
+
+  void SetIpv4 (Ptr<Ipv4> ipv4)
+  {
+    m_ipv4 = ipv4;
+  }
+
+  void PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const
+  {
+    std::ostream *os = stream->GetStream ();
+    *os << "Cluster " << m_network << "/" << m_mask.GetPrefixLength () << ", gateways";
+    for (std::vector<Ipv4Address>::const_iterator i = m_gateways.begin (); i != m_gateways.end (); ++i)
+      {
+        *os << " " << *i;
+      }
+    *os << std::endl;
+  }
+
+private:
+  /// Whether traffic for this address has to leave the cluster.
+  bool IsOutside (Ipv4Address destination) const
+  {
+    return !destination.IsMulticast () && !destination.IsBroadcast ()
+           && !m_mask.IsMatch (destination, m_network);
+  }
+
+  /// The gateway a flow hashes to; the same on every node of the cluster.
+  Ipv4Address ChooseGateway (const Ipv4Header &header, Ipv4Address source) const
+  {
+    uint8_t key[9];
+    source.Serialize (key);
+    header.GetDestination ().Serialize (key + 4);
+    key[8] = header.GetProtocol ();
+    return m_gateways[Hash32 (reinterpret_cast<const char *> (key), sizeof (key)) % m_gateways.size ()];
+  }
+
+  /// Whether this node is the given gateway, and so routes between clusters.
+  bool IsThisGateway (Ipv4Address gateway) const
+  {
+    return m_interCluster != 0 && m_ipv4->GetInterfaceForAddress (gateway) >= 0;
+  }
+
+  /// Route a packet towards the gateway its flow hashes to.
+  Ptr<Ipv4Route> RouteToGateway (Ptr<Packet> p, const Ipv4Header &header, Ipv4Address gateway,
+                                 Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
+  {
+    Ipv4Header toGateway = header;
+    toGateway.SetDestination (gateway);
+    Ptr<Ipv4Route> route = m_intraCluster->RouteOutput (p, toGateway, oif, sockerr);
+    if (route != 0)
+      {
+        route->SetDestination (header.GetDestination ());
+      }
+    return route;
+  }
+
+  Ptr<Ipv4> m_ipv4;                         //!< this node's IPv4 stack
+  Ipv4Address m_network;                    //!< cluster network address
+  Ipv4Mask m_mask;                          //!< cluster network mask
+  std::vector<Ipv4Address> m_gateways;      //!< gateways of the cluster
+  Ptr<Ipv4RoutingProtocol> m_intraCluster;  //!< routes inside the cluster
+  Ptr<Ipv4RoutingProtocol> m_interCluster;  //!< routes between clusters, gateways only
+};
+
+NS_OBJECT_ENSURE_REGISTERED (FlowHashGatewayRouting);
+
+} // namespace ns3
+
+#endif /* FLOW_HASH_GATEWAY_ROUTING_H */
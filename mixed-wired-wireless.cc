@@ -58,8 +58,12 @@
 // Note that certain mobility patterns may cause packet forwarding
 // to fail (if nodes become disconnected)
 
+#include <chrono>
+#include <limits>
+
 #include "ns3/command-line.h"
 #include "ns3/string.h"
+#include "ns3/boolean.h"
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/ssid.h"
 #include "ns3/mobility-helper.h"
@@ -73,6 +77,16 @@
 #include "ns3/csma-helper.h"
 #include "ns3/animation-interface.h"
 
+#include "anim-writer.h"
+#include "backbone-energy.h"
+#include "batched-output.h"
+#include "fast-exit.h"
+#include "phase-profiler.h"
+#include "prebuilt-install.h"
+#include "replication-shm.h"
+#include "role-tracing.h"
+#include "static-arp.h"
+
 using namespace ns3;
 
 //
@@ -91,6 +105,21 @@ CourseChangeCallback (std::string path, Ptr<const MobilityModel> model)
   std::cout << "CourseChange " << path << " x=" << position.x << ", y=" << position.y << ", z=" << position.z << std::endl;
 }
 
+//
+// Count the datagrams sent by the source and received by the sink
+//
+static void
+AppTx (uint32_t *packets, Ptr<const Packet> packet)
+{
+  (*packets)++;
+}
+
+static void
+AppRx (uint32_t *packets, Ptr<const Packet> packet, const Address &from)
+{
+  (*packets)++;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -103,6 +132,28 @@ main (int argc, char *argv[])
   uint32_t lanNodes = 2;
   uint32_t stopTime = 20;
   bool useCourseChangeCallback = false;
+  std::string traceRoles = "";
+  std::string traceMode = "ascii";
+  uint32_t traceSample = 100;
+  bool energy = false;
+  double initialEnergy = 100.0;
+  double energyResolution = 0.5;
+  bool preAssociated = false;
+  bool beaconEconomy = false;
+  bool prebuiltMobility = false;
+  bool staticArp = false;
+  bool reportEvents = false;
+  bool probes = false;
+  bool profilePhases = false;
+  double warmUp = 3.0;
+  bool animation = true;
+  bool asyncAnim = false;
+  bool animTrace = false;
+  bool pcap = true;
+  bool fastExit = false;
+  bool batchedOutput = false;
+  std::string shmName = "";
+  uint32_t shmSlot = 0;
 
   //
   // Simulation defaults are typically set next, before command line
@@ -122,6 +173,41 @@ main (int argc, char *argv[])
   cmd.AddValue ("lanNodes", "number of LAN nodes", lanNodes);
   cmd.AddValue ("stopTime", "simulation stop time (seconds)", stopTime);
   cmd.AddValue ("useCourseChangeCallback", "whether to enable course change tracing", useCourseChangeCallback);
+  cmd.AddValue ("traceRoles", "trace only these role:layer[-event] items, e.g. backbone:mac-drop,sta:app-rx "
+                "(roles: all, backbone, lan, sta; empty traces everything)", traceRoles);
+  cmd.AddValue ("traceMode", "ascii (one line per packet), sample (one packet uid in traceSample), "
+                "aggregate (packets and bytes per role, node and event every 100 ms), usdt (fire the "
+                "ns3sim:packet probe, no file output) or none", traceMode);
+  cmd.AddValue ("traceSample", "sampling period used by traceMode=sample", traceSample);
+  cmd.AddValue ("energy", "power the backbone routers from batteries and log their energy", energy);
+  cmd.AddValue ("initialEnergy", "battery capacity of each backbone router (J)", initialEnergy);
+  cmd.AddValue ("energyResolution", "smallest energy drop written to the energy log (J)", energyResolution);
+  cmd.AddValue ("preAssociated", "turn the infrastructure nets into ad hoc nets (AdhocWifiMac), with "
+                "no beacon, probe or association exchanges and no relaying by the router, so traffic can "
+                "flow from t=0; do not compare the results with access point runs", preAssociated);
+  cmd.AddValue ("beaconEconomy", "do not simulate access point beacons; stations find their access "
+                "point by active probing instead", beaconEconomy);
+  cmd.AddValue ("prebuiltMobility", "configure the station mobility model once, not per "
+                "infrastructure net; this renumbers later random streams, so results differ", prebuiltMobility);
+  cmd.AddValue ("staticArp", "fill the ARP caches of all on-link neighbors before the run", staticArp);
+  cmd.AddValue ("reportEvents", "print the number of events executed and the event rate", reportEvents);
+  cmd.AddValue ("probes", "fire the ns3sim event probes (USDT) from the scheduler", probes);
+  cmd.AddValue ("profilePhases", "read hardware counters during setup, warm-up and the measured "
+                "interval, and report IPC and misses per event", profilePhases);
+  cmd.AddValue ("warmUp", "end of the routing warm-up, start of the measured interval (seconds)", warmUp);
+  cmd.AddValue ("anim", "write a NetAnim file (see asyncAnim and animTrace)", animation);
+  cmd.AddValue ("asyncAnim", "write the NetAnim file from a background thread instead of "
+                "using AnimationInterface", asyncAnim);
+  cmd.AddValue ("animTrace", "record a binary animation trace (mixed-wireless.anim) to be turned "
+                "into NetAnim XML later by anim-convert", animTrace);
+  cmd.AddValue ("pcap", "write pcap captures of the LANs, the backbone and the sink", pcap);
+  cmd.AddValue ("fastExit", "once the results are written, exit without tearing down the "
+                "simulation; implies pcap=false", fastExit);
+  cmd.AddValue ("batchedOutput", "write the trace file in large batches from a background "
+                "writer instead of line by line", batchedOutput);
+  cmd.AddValue ("shmName", "shared memory of a replication runner to publish the metrics of "
+                "this run to", shmName);
+  cmd.AddValue ("shmSlot", "slot in shmName given to this run", shmSlot);
 
   //
   // The system global variables and the local values added to the argument
@@ -134,6 +220,24 @@ main (int argc, char *argv[])
       std::cout << "Use a simulation stop time >= 10 seconds" << std::endl;
       exit (1);
     }
+  NS_ABORT_MSG_IF (warmUp < 0 || warmUp >= stopTime,
+                   "The warm-up must end within the simulation, before " << stopTime << " seconds");
+  if (fastExit && pcap)
+    {
+      //
+      // The pcap files are buffered inside the trace helpers, which only
+      // flush them when the devices are disposed
+      //
+      std::cout << "No pcap captures with --fastExit" << std::endl;
+      pcap = false;
+    }
+
+  PhaseProfiler *profiler = 0;
+  if (profilePhases)
+    {
+      profiler = new PhaseProfiler ();
+      profiler->Begin ("setup");
+    }
   ///////////////////////////////////////////////////////////////////////////
   //                                                                       //
   // Construct the backbone                                                //
@@ -208,6 +312,18 @@ main (int argc, char *argv[])
   // the "172.16 address space
   ipAddrs.SetBase ("172.16.0.0", "255.255.255.0");
 
+  // Remember the LAN hosts and wireless stations so that tracing can be
+  // selected by role later on
+  NodeContainer lanHosts;
+  NodeContainer infraStas;
+
+  // All LANs are alike: configure their helpers once
+  CsmaHelper csmaLan;
+  csmaLan.SetChannelAttribute ("DataRate",
+                               DataRateValue (DataRate (5000000)));
+  csmaLan.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (2)));
+  MobilityHelper mobilityLan;
+  mobilityLan.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
 
   for (uint32_t i = 0; i < backboneNodes; ++i)
     {
@@ -225,11 +341,7 @@ main (int argc, char *argv[])
       // Create the CSMA net devices and install them into the nodes in our
       // collection.
       //
-      CsmaHelper csma;
-      csma.SetChannelAttribute ("DataRate",
-                                DataRateValue (DataRate (5000000)));
-      csma.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (2)));
-      NetDeviceContainer lanDevices = csma.Install (lan);
+      NetDeviceContainer lanDevices = csmaLan.Install (lan);
       //
       // Add the IPv4 protocol stack to the new LAN nodes
       //
@@ -248,7 +360,6 @@ main (int argc, char *argv[])
       // The new LAN nodes need a mobility model so we aggregate one
       // to each of the nodes we just finished building.
       //
-      MobilityHelper mobilityLan;
       Ptr<ListPositionAllocator> subnetAlloc =
         CreateObject<ListPositionAllocator> ();
       for (uint32_t j = 0; j < newLanNodes.GetN (); ++j)
@@ -257,8 +368,9 @@ main (int argc, char *argv[])
         }
       mobilityLan.PushReferenceMobilityModel (backbone.Get (i));
       mobilityLan.SetPositionAllocator (subnetAlloc);
-      mobilityLan.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
       mobilityLan.Install (newLanNodes);
+      mobilityLan.PopReferenceMobilityModel ();
+      lanHosts.Add (newLanNodes);
     }
 
   ///////////////////////////////////////////////////////////////////////////
@@ -271,6 +383,45 @@ main (int argc, char *argv[])
   // the "10.0" address space
   ipAddrs.SetBase ("10.0.0.0", "255.255.255.0");
 
+  //
+  // The infrastructure nets only differ in their channel and SSID, so the
+  // helpers are configured once, here, and each net's SSID is set on its
+  // MACs once they are installed
+  //
+  WifiHelper wifiInfra;
+  WifiMacHelper macSta;
+  WifiMacHelper macAp;
+  if (preAssociated)
+    {
+      //
+      // StaWifiMac has no way to be handed its association state, so
+      // the router and its stations share the channel through a MAC
+      // that needs no association at all.  Channel and PHY are those
+      // of the access point, but this is an IBSS: frames go straight
+      // between stations, not relayed by the router, with ad hoc
+      // addressing, so the MAC behaves differently from a BSS.
+      //
+      macSta.SetType ("ns3::AdhocWifiMac");
+      macAp.SetType ("ns3::AdhocWifiMac");
+    }
+  else if (beaconEconomy)
+    {
+      //
+      // Without beacons the stations probe for their access point,
+      // and must not give up on it for missing beacons
+      //
+      macSta.SetType ("ns3::StaWifiMac",
+                      "ActiveProbing", BooleanValue (true),
+                      "MaxMissedBeacons", UintegerValue (std::numeric_limits<uint32_t>::max ()));
+      macAp.SetType ("ns3::ApWifiMac",
+                     "BeaconGeneration", BooleanValue (false));
+    }
+  else
+    {
+      macSta.SetType ("ns3::StaWifiMac");
+      macAp.SetType ("ns3::ApWifiMac");
+    }
+
   for (uint32_t i = 0; i < backboneNodes; ++i)
     {
       NS_LOG_INFO ("Configuring wireless network for backbone node " << i);
@@ -286,8 +437,6 @@ main (int argc, char *argv[])
       //
       // Create an infrastructure network
       //
-      WifiHelper wifiInfra;
-      WifiMacHelper macInfra;
       wifiPhy.SetChannel (wifiChannel.Create ());
       // Create unique ssids for these networks
       std::string ssidString ("wifi-infra");
@@ -296,13 +445,9 @@ main (int argc, char *argv[])
       ssidString += ss.str ();
       Ssid ssid = Ssid (ssidString);
       // setup stas
-      macInfra.SetType ("ns3::StaWifiMac",
-                        "Ssid", SsidValue (ssid));
-      NetDeviceContainer staDevices = wifiInfra.Install (wifiPhy, macInfra, stas);
+      NetDeviceContainer staDevices = InstallWithSsid (wifiInfra, wifiPhy, macSta, stas, ssid);
       // setup ap.
-      macInfra.SetType ("ns3::ApWifiMac",
-                        "Ssid", SsidValue (ssid));
-      NetDeviceContainer apDevices = wifiInfra.Install (wifiPhy, macInfra, backbone.Get (i));
+      NetDeviceContainer apDevices = InstallWithSsid (wifiInfra, wifiPhy, macAp, backbone.Get (i), ssid);
       // Collect all of these new devices
       NetDeviceContainer infraDevices (apDevices, staDevices);
 
@@ -331,11 +476,60 @@ main (int argc, char *argv[])
         }
       mobility.PushReferenceMobilityModel (backbone.Get (i));
       mobility.SetPositionAllocator (subnetAlloc);
-      mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
-                                 "Bounds", RectangleValue (Rectangle (-10, 10, -10, 10)),
-                                 "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=3]"),
-                                 "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.4]"));
+      if (i == 0 || !prebuiltMobility)
+        {
+          //
+          // Configuring the model creates its two constant random variables,
+          // each taking the next random stream.  Doing it for every net, as
+          // the script always has, keeps the streams of all later random
+          // variables, and so the results of default runs, unchanged.
+          //
+          mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
+                                     "Bounds", RectangleValue (Rectangle (-10, 10, -10, 10)),
+                                     "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=3]"),
+                                     "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.4]"));
+        }
       mobility.Install (stas);
+      mobility.PopReferenceMobilityModel ();
+      infraStas.Add (stas);
+    }
+
+  if (staticArp)
+    {
+      //
+      // Every address is assigned by now, so the ARP caches can be filled
+      // from the address plan instead of by ARP exchanges
+      //
+      uint32_t arpEntries = PopulateArpCaches ();
+      NS_LOG_INFO ("Added " << arpEntries << " static ARP entries");
+    }
+
+  if (beaconEconomy && !preAssociated)
+    {
+      //
+      // A beacon of about 100 bytes at the 6 Mb/s OFDM basic rate is 20 us
+      // of preamble and header plus 35 symbols of 4 us, sent every 102.4 ms
+      //
+      NS_LOG_INFO ("Beacons are not simulated; they would take " << 100 * 160e-6 / 102.4e-3
+                   << "% of the airtime of each infrastructure channel");
+    }
+
+  ///////////////////////////////////////////////////////////////////////////
+  //                                                                       //
+  // Energy configuration                                                  //
+  //                                                                       //
+  ///////////////////////////////////////////////////////////////////////////
+
+  //
+  // The backbone routers run on batteries that feed both of their wifi
+  // radios.  Energy is accounted on radio state changes only.
+  //
+  BackboneEnergy backboneEnergy;
+  if (energy)
+    {
+      NS_LOG_INFO ("Installing energy models on the backbone routers");
+      backboneEnergy.Install (backbone, initialEnergy, Seconds (stopTime));
+      backboneEnergy.EnableLog ("mixed-wireless.energy", energyResolution);
     }
 
   ///////////////////////////////////////////////////////////////////////////
@@ -369,6 +563,8 @@ main (int argc, char *argv[])
                      Address (InetSocketAddress (remoteAddr, port)));
 
   ApplicationContainer apps = onoff.Install (appSource);
+  uint32_t txPackets = 0;
+  apps.Get (0)->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&AppTx, &txPackets));
   apps.Start (Seconds (3));
   apps.Stop (Seconds (stopTime - 1));
 
@@ -376,6 +572,8 @@ main (int argc, char *argv[])
   PacketSinkHelper sink ("ns3::UdpSocketFactory",
                          InetSocketAddress (Ipv4Address::GetAny (), port));
   apps = sink.Install (appSink);
+  uint32_t rxPackets = 0;
+  apps.Get (0)->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&AppRx, &rxPackets));
   apps.Start (Seconds (3));
 
   ///////////////////////////////////////////////////////////////////////////
@@ -391,24 +589,100 @@ main (int argc, char *argv[])
   // Let's set up some ns-2-like ascii traces, using another helper class
   //
   AsciiTraceHelper ascii;
-  Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream ("mixed-wireless.tr");
-  wifiPhy.EnableAsciiAll (stream);
-  csma.EnableAsciiAll (stream);
-  internet.EnableAsciiIpv4All (stream);
-
-  // Csma captures in non-promiscuous mode
-  csma.EnablePcapAll ("mixed-wireless", false);
-  // pcap captures on the backbone wifi devices
-  wifiPhy.EnablePcap ("mixed-wireless", backboneDevices, false);
-  // pcap trace on the application data sink
-  wifiPhy.EnablePcap ("mixed-wireless", appSink->GetId (), 0);
+  BatchedOutput traceFile;
+  Ptr<OutputStreamWrapper> stream;
+  // None traces nothing, and in usdt mode the probes replace the trace file
+  bool writeTraceFile = traceMode != "none" && traceMode != "usdt";
+  if (writeTraceFile && batchedOutput)
+    {
+      traceFile.Open ("mixed-wireless.tr");
+      stream = Create<OutputStreamWrapper> (traceFile.GetStream ());
+    }
+  else if (writeTraceFile)
+    {
+      stream = ascii.CreateFileStream ("mixed-wireless.tr");
+    }
+  RoleTracer roleTracer;
+  if (traceMode == "none")
+    {
+      NS_LOG_INFO ("No packet traces");
+    }
+  else if (traceRoles.empty () && traceMode == "ascii")
+    {
+      wifiPhy.EnableAsciiAll (stream);
+      csma.EnableAsciiAll (stream);
+      internet.EnableAsciiIpv4All (stream);
+    }
+  else
+    {
+      //
+      // Only connect the trace sources that were asked for, on the nodes
+      // playing the requested roles
+      //
+      roleTracer.AddRole ("all", NodeContainer::GetGlobal ());
+      roleTracer.AddRole ("backbone", backbone);
+      roleTracer.AddRole ("lan", lanHosts);
+      roleTracer.AddRole ("sta", infraStas);
+      if (traceMode == "sample")
+        {
+          roleTracer.SetSampling (traceSample);
+        }
+      else if (traceMode == "aggregate")
+        {
+          roleTracer.SetAggregation (MilliSeconds (100));
+        }
+      else if (traceMode == "usdt")
+        {
+          roleTracer.SetUsdt ();
+        }
+      else if (traceMode != "ascii")
+        {
+          NS_ABORT_MSG ("Unknown traceMode \"" << traceMode << "\"");
+        }
+      // Without explicit roles, cover what the global ascii trace would
+      roleTracer.Enable (traceRoles.empty () ? "all:mac,all:ip" : traceRoles, stream);
+      NS_LOG_INFO ("Connected " << roleTracer.GetNBindings () << " role trace sinks");
+    }
+
+  if (pcap)
+    {
+      // Csma captures in non-promiscuous mode
+      csma.EnablePcapAll ("mixed-wireless", false);
+      // pcap captures on the backbone wifi devices
+      wifiPhy.EnablePcap ("mixed-wireless", backboneDevices, false);
+      // pcap trace on the application data sink
+      wifiPhy.EnablePcap ("mixed-wireless", appSink->GetId (), 0);
+    }
 
   if (useCourseChangeCallback == true)
     {
       Config::Connect ("/NodeList/*/$ns3::MobilityModel/CourseChange", MakeCallback (&CourseChangeCallback));
     }
 
-  AnimationInterface anim ("mixed-wireless.xml");
+  //
+  // The asynchronous writer only records positions and MAC packet events,
+  // but keeps all XML output off the simulation thread
+  //
+  AnimationInterface *anim = 0;
+  AnimWriter animWriter;
+  if (!animation)
+    {
+      NS_LOG_INFO ("No NetAnim output");
+    }
+  else if (animTrace)
+    {
+      animWriter.Open ("mixed-wireless.anim", AnimWriter::BINARY);
+      animWriter.Install (NodeContainer::GetGlobal ());
+    }
+  else if (asyncAnim)
+    {
+      animWriter.Open ("mixed-wireless.xml");
+      animWriter.Install (NodeContainer::GetGlobal ());
+    }
+  else
+    {
+      anim = new AnimationInterface ("mixed-wireless.xml");
+    }
 
   ///////////////////////////////////////////////////////////////////////////
   //                                                                       //
@@ -416,8 +690,62 @@ main (int argc, char *argv[])
   //                                                                       //
   ///////////////////////////////////////////////////////////////////////////
 
+  if (probes)
+    {
+      NS_ABORT_MSG_IF (!ProbedScheduler::IsAvailable (), "Built without <sys/sdt.h>, no probes to fire");
+      ObjectFactory scheduler ("ns3::ProbedScheduler");
+      Simulator::SetScheduler (scheduler);
+    }
+
   NS_LOG_INFO ("Run Simulation.");
   Simulator::Stop (Seconds (stopTime));
+  if (profiler != 0)
+    {
+      // OLSR converges during the first seconds; measure after that
+      profiler->Begin ("warm-up");
+      profiler->BeginAt (Seconds (warmUp), "measured");
+    }
+  std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now ();
   Simulator::Run ();
+  double runSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - runStart).count ();
+  if (profiler != 0)
+    {
+      profiler->Report (std::cout);
+      delete profiler;
+    }
+  if (reportEvents)
+    {
+      std::cout << "Executed " << Simulator::GetEventCount () << " events in " << runSeconds
+                << " s (" << Simulator::GetEventCount () / runSeconds << " events/s)" << std::endl;
+    }
+  roleTracer.Flush ();
+  traceFile.Close ();
+  backboneEnergy.Close ();
+  animWriter.Close ();
+  if (!shmName.empty ())
+    {
+      ScenarioMetrics metrics;
+      metrics["nodes"] = NodeList::GetNNodes ();
+      metrics["events"] = Simulator::GetEventCount ();
+      metrics["runSeconds"] = runSeconds;
+      metrics["txPackets"] = txPackets;
+      metrics["rxPackets"] = rxPackets;
+      metrics["deliveryRatio"] = txPackets > 0 ? static_cast<double> (rxPackets) / txPackets : 0;
+      ReplicationShm shm;
+      shm.Attach (shmName);
+      shm.Publish (shmSlot, RngSeedManager::GetRun (), metrics);
+    }
+  if (fastExit)
+    {
+      FastExit quickExit;
+      if (stream != 0)
+        {
+          quickExit.AddStream (stream);
+        }
+      // AnimationInterface completes its XML file when deleted
+      quickExit.Add ([anim] () { delete anim; });
+      quickExit.Exit (0);
+    }
   Simulator::Destroy ();
+  delete anim;
 }
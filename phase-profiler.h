@@ -0,0 +1,276 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef PHASE_PROFILER_H
+#define PHASE_PROFILER_H
+
+//
+// Hardware performance counters per phase of a run.
+//
+// The profiler opens one perf_event_open group on the simulation thread:
+// cycles, instructions, last level cache misses and branch misses, user
+// space only.  Begin () closes the current phase and opens the next one;
+// each phase records the counter deltas, the wall time and the number of
+// simulator events executed, and Report () prints IPC and misses per
+// event for every phase.  Phases that end at a simulation time can be
+// started by a scheduled event, see BeginAt ().
+//
+// Counters that cannot be opened (no PMU in a VM, or a restrictive
+// perf_event_paranoid) are left out of the report; without cycles, only
+// wall time and events are reported.
+//
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+/**
+ * \brief Reads hardware counters around the phases of a run.
+ */
+class PhaseProfiler
+{
+public:
+  /// The counters, in group order.
+  enum Counter
+  {
+    CYCLES = 0,
+    INSTRUCTIONS,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    N_COUNTERS
+  };
+
+  PhaseProfiler ()
+    : m_leader (-1),
+      m_open (false)
+  {
+    static const uint64_t configs[N_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (uint32_t c = 0; c < N_COUNTERS; ++c)
+      {
+        m_slot[c] = -1;
+        struct perf_event_attr attr;
+        std::memset (&attr, 0, sizeof (attr));
+        attr.size = sizeof (attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[c];
+        attr.disabled = (m_leader == -1);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+          | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = syscall (__NR_perf_event_open, &attr, 0, -1, m_leader, 0);
+        if (fd < 0)
+          {
+            // The group is only worth having if cycles can be counted
+            if (c == CYCLES)
+              {
+                break;
+              }
+            continue;
+          }
+        if (m_leader == -1)
+          {
+            m_leader = fd;
+          }
+        m_slot[c] = m_fds.size ();
+        m_fds.push_back (fd);
+      }
+    if (m_leader != -1)
+      {
+        ioctl (m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+      }
+  }
+
+  ~PhaseProfiler ()
+  {
+    for (size_t i = 0; i < m_fds.size (); ++i)
+      {
+        close (m_fds[i]);
+      }
+  }
+
+  /**
+   * \return whether any hardware counter could be opened
+   */
+  bool IsAvailable () const
+  {
+    return m_leader != -1;
+  }
+
+  /**
+   * \brief End the current phase, if any, and start a new one.
+   * \param name the name of the new phase
+   */
+  void Begin (std::string name)
+  {
+    End ();
+    m_current.name = name;
+    m_current.events = Simulator::GetEventCount ();
+    m_current.start = std::chrono::steady_clock::now ();
+    Read (m_current.counts);
+    m_open = true;
+  }
+
+  /**
+   * \brief Start a new phase once the simulation reaches a given time.
+   * \param time simulation time at which the phase starts
+   * \param name the name of the phase
+   */
+  void BeginAt (Time time, std::string name)
+  {
+    Simulator::Schedule (time - Simulator::Now (), &PhaseProfiler::Begin, this, name);
+  }
+
+  /**
+   * \brief End the current phase.
+   */
+  void End ()
+  {
+    if (!m_open)
+      {
+        return;
+      }
+    double counts[N_COUNTERS];
+    Read (counts);
+    Phase phase = m_current;
+    phase.events = Simulator::GetEventCount () - m_current.events;
+    phase.wall = std::chrono::duration<double> (std::chrono::steady_clock::now () - m_current.start).count ();
+    for (uint32_t c = 0; c < N_COUNTERS; ++c)
+      {
+        phase.counts[c] = counts[c] - m_current.counts[c];
+      }
+    m_phases.push_back (phase);
+    m_open = false;
+  }
+
+  /**
+   * \brief Print one line per phase: wall time, events and, where
+   * available, cycles, instructions, IPC and misses per event.
+   * \param os where to print
+   */
+  void Report (std::ostream &os)
+  {
+    End ();
+    if (!IsAvailable ())
+      {
+        os << "Hardware counters unavailable (see /proc/sys/kernel/perf_event_paranoid); "
+           << "reporting wall time and events only" << std::endl;
+      }
+    os << "phase wall(s) events";
+    if (IsAvailable ())
+      {
+        os << " cycles instructions IPC";
+        if (m_slot[LLC_MISSES] != -1)
+          {
+            os << " LLC-misses/event";
+          }
+        if (m_slot[BRANCH_MISSES] != -1)
+          {
+            os << " branch-misses/event";
+          }
+      }
+    os << std::endl;
+    for (size_t i = 0; i < m_phases.size (); ++i)
+      {
+        const Phase &p = m_phases[i];
+        double events = p.events > 0 ? p.events : 1;
+        os << p.name << " " << p.wall << " " << p.events;
+        if (IsAvailable ())
+          {
+            os << " " << std::setprecision (4) << p.counts[CYCLES] << " " << p.counts[INSTRUCTIONS];
+            os << " " << (p.counts[CYCLES] > 0 ? p.counts[INSTRUCTIONS] / p.counts[CYCLES] : 0);
+            if (m_slot[LLC_MISSES] != -1)
+              {
+                os << " " << p.counts[LLC_MISSES] / events;
+              }
+            if (m_slot[BRANCH_MISSES] != -1)
+              {
+                os << " " << p.counts[BRANCH_MISSES] / events;
+              }
+            os << std::setprecision (6);
+          }
+        os << std::endl;
+      }
+  }
+
+private:
+  /// Counter values, wall time and events of one phase.
+  struct Phase
+  {
+    std::string name;                                //!< phase name
+    double counts[N_COUNTERS];                       //!< counter deltas
+    uint64_t events;                                 //!< events executed
+    double wall;                                     //!< wall time, in seconds
+    std::chrono::steady_clock::time_point start;     //!< wall clock at the start
+  };
+
+  /// Read the group, scaled for multiplexing; missing counters read 0.
+  void Read (double counts[N_COUNTERS])
+  {
+    for (uint32_t c = 0; c < N_COUNTERS; ++c)
+      {
+        counts[c] = 0;
+      }
+    if (m_leader == -1)
+      {
+        return;
+      }
+    uint64_t buffer[3 + N_COUNTERS];
+    if (read (m_leader, buffer, sizeof (buffer)) < static_cast<ssize_t> (3 * sizeof (uint64_t)))
+      {
+        return;
+      }
+    uint64_t nr = buffer[0];
+    double scale = buffer[2] > 0 ? static_cast<double> (buffer[1]) / buffer[2] : 1;
+    for (uint32_t c = 0; c < N_COUNTERS; ++c)
+      {
+        if (m_slot[c] != -1 && static_cast<uint64_t> (m_slot[c]) < nr)
+          {
+            counts[c] = buffer[3 + m_slot[c]] * scale;
+          }
+      }
+  }
+
+  std::vector<int> m_fds;          //!< open counters, leader first
+  int m_leader;                    //!< group leader, -1 without counters
+  int m_slot[N_COUNTERS];          //!< position of each counter in the group, -1 if not open
+  bool m_open;                     //!< whether a phase is running
+  Phase m_current;                 //!< the running phase, counts at its start
+  std::vector<Phase> m_phases;     //!< finished phases
+};
+
+} // namespace ns3
+
+#endif /* PHASE_PROFILER_H */
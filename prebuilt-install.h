@@ -0,0 +1,71 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef PREBUILT_INSTALL_H
+#define PREBUILT_INSTALL_H
+
+//
+// Installs that reuse helpers configured once.
+//
+// Every SetType (), SetMobilityModel () or SetChannelAttribute () call
+// looks its type and attributes up by name and converts the attribute
+// values, parsing strings such as
+// "ns3::ConstantRandomVariable[Constant=2]" into new objects.  The
+// scripts used to repeat those calls for every router, although the
+// infrastructure nets only differ in their channel and their SSID.  The
+// helpers are now configured once, before the loops, and the SSID, the
+// only per-net MAC attribute, is set on the installed MACs instead.
+//
+// The station mobility model is still configured per net unless
+// --prebuiltMobility is given: its constant random variables take random
+// streams, and creating fewer of them would renumber every later stream.
+//
+
+#include "ns3/net-device-container.h"
+#include "ns3/node-container.h"
+#include "ns3/ssid.h"
+#include "ns3/wifi-helper.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/wifi-net-device.h"
+
+namespace ns3 {
+
+/**
+ * \brief Install wifi devices from prebuilt helpers and give their MACs
+ * an SSID.
+ * \param wifi the wifi helper
+ * \param phy the PHY helper, already pointing at the channel to use
+ * \param mac the MAC helper; its SSID, if any, is overridden
+ * \param nodes the nodes to install on
+ * \param ssid the SSID of the new devices
+ * \return the new devices
+ */
+inline NetDeviceContainer
+InstallWithSsid (const WifiHelper &wifi, const WifiPhyHelper &phy, const WifiMacHelper &mac,
+                 NodeContainer nodes, Ssid ssid)
+{
+  NetDeviceContainer devices = wifi.Install (phy, mac, nodes);
+  for (uint32_t i = 0; i < devices.GetN (); ++i)
+    {
+      DynamicCast<WifiNetDevice> (devices.Get (i))->GetMac ()->SetSsid (ssid);
+    }
+  return devices;
+}
+
+} // namespace ns3
+
+#endif /* PREBUILT_INSTALL_H */
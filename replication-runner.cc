@@ -0,0 +1,402 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Run replications of mixed-wired-wireless as concurrent processes and
+// aggregate their metrics.
+//
+//   ./replication-runner --runs=40 --jobs=8 --args="--backboneNodes=30 --stopTime=60"
+//
+// runs ./mixed-wired-wireless with RngRun 1 to 40, at most 8 at a time,
+// and prints one table with the number of replications, mean, standard
+// deviation, minimum and maximum of every metric.  The workers publish
+// their metrics through shared memory (replication-shm.h), and the runner
+// folds each replication into running statistics as soon as its worker
+// exits.
+//
+// The default --args turn off every output file of the workers (pcap
+// captures, packet traces and NetAnim) and their teardown; keep them when
+// giving other arguments.  Each worker still runs in a directory of its
+// own, with its output in the file "log" and whatever files the arguments
+// given do turn on; it is removed after the worker exits unless it failed
+// or --keepRunDirs is given.
+//
+// A worker is only started when the predicted peak memory of all running
+// workers, its own included, fits in the memory budget: MemAvailable at
+// start, or --memBudget.  Predictions come from an RssModel (rss-model.h)
+// of peak RSS against node count (from --args for mixed-wired-wireless,
+// from --nodes for other programs), calibrated with the ru_maxrss of every
+// successful worker and kept in --calibration between sweeps.  The file
+// only serves sweeps of the same program and arguments, node counts
+// aside; for other arguments it is ignored with a warning and replaced at
+// the end.  Until there is a calibration, the first worker runs alone.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ns3/core-module.h"
+
+#include "replication-shm.h"
+#include "rss-model.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("ReplicationRunner");
+
+//
+// Running mean and variance of one metric (Welford's method).
+//
+struct RunningStats
+{
+  RunningStats ()
+    : n (0),
+      mean (0),
+      m2 (0),
+      min (0),
+      max (0)
+  {
+  }
+
+  void Add (double x)
+  {
+    n++;
+    double delta = x - mean;
+    mean += delta / n;
+    m2 += delta * (x - mean);
+    min = n == 1 ? x : std::min (min, x);
+    max = n == 1 ? x : std::max (max, x);
+  }
+
+  double StdDev (void) const
+  {
+    return n > 1 ? std::sqrt (m2 / (n - 1)) : 0;
+  }
+
+  uint64_t n;  //!< replications seen
+  double mean; //!< running mean
+  double m2;   //!< sum of squared deviations from the mean
+  double min;  //!< smallest value
+  double max;  //!< largest value
+};
+
+//
+// Start one worker in its own directory, with its standard output and
+// error going to the file "log" there; return its process id.
+//
+static pid_t
+Spawn (std::string program, const std::vector<std::string> &args, std::string dir)
+{
+  std::vector<char *> argv;
+  argv.push_back (const_cast<char *> (program.c_str ()));
+  for (size_t i = 0; i < args.size (); ++i)
+    {
+      argv.push_back (const_cast<char *> (args[i].c_str ()));
+    }
+  argv.push_back (0);
+
+  pid_t pid = fork ();
+  NS_ABORT_MSG_IF (pid < 0, "Cannot fork");
+  if (pid == 0)
+    {
+      // Keep the workers' output off the table, and with their run
+      int log = -1;
+      if (chdir (dir.c_str ()) != 0
+          || (log = open ("log", O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0
+          || dup2 (log, STDOUT_FILENO) < 0 || dup2 (log, STDERR_FILENO) < 0)
+        {
+          _exit (127);
+        }
+      close (log);
+      execv (program.c_str (), &argv[0]);
+      std::cerr << "Cannot run " << program << std::endl;
+      _exit (127);
+    }
+  return pid;
+}
+
+//
+// Node count of the mixed-wired-wireless topology the worker arguments
+// describe; the defaults are those of the script.  Other programs have to
+// be given their node count with --nodes.
+//
+static uint32_t
+ScenarioNodes (const std::vector<std::string> &args)
+{
+  uint32_t backboneNodes = 10;
+  uint32_t infraNodes = 2;
+  uint32_t lanNodes = 2;
+  for (size_t i = 0; i < args.size (); ++i)
+    {
+      std::string::size_type eq = args[i].find ('=');
+      if (eq == std::string::npos)
+        {
+          continue;
+        }
+      std::string name = args[i].substr (0, eq);
+      uint32_t value = std::strtoul (args[i].c_str () + eq + 1, 0, 10);
+      if (name == "--backboneNodes")
+        {
+          backboneNodes = value;
+        }
+      else if (name == "--infraNodes")
+        {
+          infraNodes = value;
+        }
+      else if (name == "--lanNodes")
+        {
+          lanNodes = value;
+        }
+    }
+  return backboneNodes * (lanNodes + infraNodes - 1);
+}
+
+//
+// MemAvailable of /proc/meminfo, in KiB; 0 if it cannot be read.
+//
+static uint64_t
+MemAvailableKiB (void)
+{
+  std::ifstream meminfo ("/proc/meminfo");
+  std::string key;
+  uint64_t value;
+  std::string unit;
+  while (meminfo >> key >> value >> unit)
+    {
+      if (key == "MemAvailable:")
+        {
+          return value;
+        }
+    }
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string program = "./mixed-wired-wireless";
+  std::string args = "--pcap=false --traceMode=none --anim=false --fastExit=true";
+  uint32_t runs = 10;
+  uint32_t firstRun = 1;
+  uint32_t jobs = sysconf (_SC_NPROCESSORS_ONLN);
+  bool keepRunDirs = false;
+  uint64_t memBudget = 0;
+  std::string calibration = "replication-rss.txt";
+  uint32_t nodes = 0;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("program", "worker program; it must accept --shmName and --shmSlot", program);
+  cmd.AddValue ("args", "arguments of every worker, separated by spaces", args);
+  cmd.AddValue ("runs", "number of replications", runs);
+  cmd.AddValue ("firstRun", "RngRun of the first replication; later ones count up", firstRun);
+  cmd.AddValue ("jobs", "most workers running at a time", jobs);
+  cmd.AddValue ("keepRunDirs", "keep the directory each worker ran in", keepRunDirs);
+  cmd.AddValue ("memBudget", "memory the workers may use together (MiB); 0 for MemAvailable "
+                "at start", memBudget);
+  cmd.AddValue ("nodes", "node count of each run, for the memory prediction; worked out from "
+                "--args when the program is mixed-wired-wireless", nodes);
+  cmd.AddValue ("calibration", "file of measured peak memory per node count, read at start "
+                "and updated at the end", calibration);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (jobs == 0, "Need at least one job");
+  if (program.find ('/') == std::string::npos)
+    {
+      program = "./" + program;
+    }
+  char *cwd = getcwd (0, 0);
+  if (program[0] != '/')
+    {
+      // The workers run in their own directories
+      program = std::string (cwd) + "/" + program;
+    }
+  free (cwd);
+
+  std::vector<std::string> workerArgs;
+  std::istringstream split (args);
+  std::string arg;
+  while (split >> arg)
+    {
+      workerArgs.push_back (arg);
+    }
+
+  if (nodes == 0)
+    {
+      std::string::size_type slash = program.rfind ('/');
+      NS_ABORT_MSG_IF (program.substr (slash + 1) != "mixed-wired-wireless",
+                       "Give the node count of " << program << " with --nodes");
+      nodes = ScenarioNodes (workerArgs);
+    }
+  uint64_t budgetKiB = memBudget > 0 ? memBudget * 1024 : MemAvailableKiB ();
+  NS_ABORT_MSG_IF (budgetKiB == 0, "Cannot read MemAvailable; give --memBudget");
+  // What the calibrated runs have in common: all but the node count
+  std::string key = program.substr (program.rfind ('/') + 1);
+  for (size_t i = 0; i < workerArgs.size (); ++i)
+    {
+      std::string name = workerArgs[i].substr (0, workerArgs[i].find ('='));
+      if (name != "--backboneNodes" && name != "--infraNodes" && name != "--lanNodes")
+        {
+          key += " " + workerArgs[i];
+        }
+    }
+  RssModel model;
+  if (!model.Load (calibration, key))
+    {
+      std::cerr << "Ignoring " << calibration << ", made with other --program or --args;"
+                << " give another --calibration to keep it" << std::endl;
+    }
+
+  char workTemplate[] = "/tmp/replications-XXXXXX";
+  NS_ABORT_MSG_IF (mkdtemp (workTemplate) == 0, "Cannot create a work directory");
+  std::string workDir = workTemplate;
+
+  std::stringstream shmName;
+  shmName << "/ns3sim-replications-" << getpid ();
+  ReplicationShm shm;
+  shm.Create (shmName.str (), jobs);
+
+  std::map<pid_t, uint32_t> slotOf;    // running workers
+  std::map<pid_t, uint64_t> runOf;
+  std::map<pid_t, uint64_t> reservedOf; // predicted peak, KiB
+  uint64_t reserved = 0;
+  uint32_t mostRunning = 0;
+  std::vector<uint32_t> freeSlots;
+  for (uint32_t i = jobs; i > 0; --i)
+    {
+      freeSlots.push_back (i - 1);
+    }
+  std::map<std::string, RunningStats> stats;
+  uint32_t failed = 0;
+  uint32_t next = 0;
+
+  while (next < runs || !slotOf.empty ())
+    {
+      while (next < runs && !freeSlots.empty ())
+        {
+          uint64_t need = model.Predict (nodes);
+          if (!slotOf.empty () && (!model.IsCalibrated () || reserved + need > budgetKiB))
+            {
+              break;
+            }
+          if (slotOf.empty () && need > budgetKiB)
+            {
+              std::cerr << "Replication " << firstRun + next << " is predicted to need " << need / 1024
+                        << " MiB, more than the budget of " << budgetKiB / 1024 << " MiB" << std::endl;
+            }
+          uint32_t slot = freeSlots.back ();
+          freeSlots.pop_back ();
+          uint64_t run = firstRun + next++;
+          std::stringstream dir;
+          dir << workDir << "/run" << run;
+          NS_ABORT_MSG_IF (mkdir (dir.str ().c_str (), 0755) != 0, "Cannot create " << dir.str ());
+          std::vector<std::string> a (workerArgs);
+          std::stringstream rngRun, shmSlot;
+          rngRun << "--RngRun=" << run;
+          shmSlot << "--shmSlot=" << slot;
+          a.push_back (rngRun.str ());
+          a.push_back ("--shmName=" + shmName.str ());
+          a.push_back (shmSlot.str ());
+          shm.Clear (slot);
+          pid_t pid = Spawn (program, a, dir.str ());
+          slotOf[pid] = slot;
+          runOf[pid] = run;
+          reservedOf[pid] = need;
+          reserved += need;
+          mostRunning = std::max<uint32_t> (mostRunning, slotOf.size ());
+        }
+
+      int status;
+      struct rusage usage;
+      pid_t pid = wait4 (-1, &status, 0, &usage);
+      NS_ABORT_MSG_IF (pid < 0, "wait failed");
+      if (slotOf.find (pid) == slotOf.end ())
+        {
+          continue;
+        }
+      uint32_t slot = slotOf[pid];
+      uint64_t run = runOf[pid];
+      reserved -= reservedOf[pid];
+      slotOf.erase (pid);
+      runOf.erase (pid);
+      reservedOf.erase (pid);
+      freeSlots.push_back (slot);
+
+      uint64_t published;
+      ScenarioMetrics metrics;
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != 0
+          || !shm.Read (slot, published, metrics) || published != run)
+        {
+          std::cerr << "Replication " << run << " failed, see " << workDir << "/run" << run << "/log" << std::endl;
+          failed++;
+          continue;
+        }
+      // ru_maxrss is in KiB; a failed worker may not have reached its peak
+      model.Add (nodes, usage.ru_maxrss);
+      for (ScenarioMetrics::const_iterator m = metrics.begin (); m != metrics.end (); ++m)
+        {
+          stats[m->first].Add (m->second);
+        }
+      stats["peakRssMiB"].Add (usage.ru_maxrss / 1024.0);
+      if (!keepRunDirs)
+        {
+          std::stringstream rm;
+          rm << "rm -rf " << workDir << "/run" << run;
+          NS_ABORT_MSG_IF (std::system (rm.str ().c_str ()) != 0, "Cannot remove " << workDir << "/run" << run);
+        }
+    }
+  if (!keepRunDirs && failed == 0)
+    {
+      rmdir (workDir.c_str ());
+    }
+  if (!model.Save (calibration))
+    {
+      std::cerr << "Cannot write " << calibration << std::endl;
+    }
+
+  std::cout << std::left << std::setw (20) << "metric" << std::right
+            << std::setw (6) << "n" << std::setw (14) << "mean" << std::setw (14) << "stddev"
+            << std::setw (14) << "min" << std::setw (14) << "max" << std::endl;
+  for (std::map<std::string, RunningStats>::const_iterator s = stats.begin (); s != stats.end (); ++s)
+    {
+      std::cout << std::left << std::setw (20) << s->first << std::right
+                << std::setw (6) << s->second.n << std::setw (14) << s->second.mean
+                << std::setw (14) << s->second.StdDev () << std::setw (14) << s->second.min
+                << std::setw (14) << s->second.max << std::endl;
+    }
+  std::cout << "Predicted peak " << model.Predict (nodes) / 1024 << " MiB per run of " << nodes
+            << " nodes, budget " << budgetKiB / 1024 << " MiB, peak concurrency " << mostRunning
+            << std::endl;
+  if (failed > 0)
+    {
+      std::cout << failed << " of " << runs << " replications failed" << std::endl;
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,249 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef REPLICATION_SHM_H
+#define REPLICATION_SHM_H
+
+//
+// Metrics of concurrent replications, passed through shared memory.
+//
+// The replication runner creates a POSIX shared memory object with one
+// slot per worker process it runs at a time, and tells each worker its
+// slot on the command line.  A worker publishes its metrics into its slot
+// at the end of the run; the runner reads them once the worker has exited
+// and reuses the slot for the next replication.  No metrics files are
+// written.
+//
+// Each slot is written by one process only and guarded by a sequence
+// count: odd while the worker writes, even when it is done, 0 when
+// nothing was published.  A reader copies the slot and checks that the
+// count did not change meanwhile, so it never waits for the writer and
+// never sees a half-written slot.
+//
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ns3/abort.h"
+
+#include "scenario-runner.h"
+
+namespace ns3 {
+
+/**
+ * \brief Shared memory slots holding the metrics of one replication each.
+ */
+class ReplicationShm
+{
+public:
+  /// Most metrics a slot holds.
+  static const uint32_t MAX_METRICS = 16;
+  /// Longest metric name, terminating null included.
+  static const uint32_t NAME_SIZE = 32;
+
+  ReplicationShm ()
+    : m_header (0),
+      m_size (0),
+      m_owner (false)
+  {
+  }
+
+  ~ReplicationShm ()
+  {
+    if (m_header != 0)
+      {
+        munmap (m_header, m_size);
+      }
+    if (m_owner)
+      {
+        shm_unlink (m_name.c_str ());
+      }
+  }
+
+  /**
+   * \brief Create the shared memory object; it is removed again when this
+   * object is destroyed.
+   * \param name shared memory object name, starting with '/'
+   * \param slots number of slots
+   */
+  void Create (std::string name, uint32_t slots)
+  {
+    int fd = shm_open (name.c_str (), O_RDWR | O_CREAT | O_EXCL, 0600);
+    NS_ABORT_MSG_IF (fd < 0, "Cannot create shared memory " << name << ": " << std::strerror (errno));
+    m_name = name;
+    m_owner = true;
+    m_size = sizeof (Header) + slots * sizeof (Slot);
+    NS_ABORT_MSG_IF (ftruncate (fd, m_size) != 0, "Cannot size shared memory " << name);
+    Map (fd);
+    m_header->magic = MAGIC;
+    m_header->slots = slots;
+    for (uint32_t i = 0; i < slots; ++i)
+      {
+        new (&GetSlot (i).seq) std::atomic<uint32_t> (0);
+      }
+  }
+
+  /**
+   * \brief Map the shared memory object made by Create () in another
+   * process.
+   * \param name shared memory object name
+   */
+  void Attach (std::string name)
+  {
+    int fd = shm_open (name.c_str (), O_RDWR, 0);
+    NS_ABORT_MSG_IF (fd < 0, "Cannot open shared memory " << name << ": " << std::strerror (errno));
+    m_name = name;
+    struct stat st;
+    NS_ABORT_MSG_IF (fstat (fd, &st) != 0 || st.st_size < static_cast<off_t> (sizeof (Header)),
+                     "Shared memory " << name << " is not set up");
+    m_size = st.st_size;
+    Map (fd);
+    NS_ABORT_MSG_IF (m_header->magic != MAGIC
+                     || m_size != sizeof (Header) + m_header->slots * sizeof (Slot),
+                     "Shared memory " << name << " has an unknown layout");
+  }
+
+  /**
+   * \return the number of slots
+   */
+  uint32_t GetNSlots (void) const
+  {
+    return m_header->slots;
+  }
+
+  /**
+   * \brief Write the metrics of a replication into a slot.
+   * \param slot the slot of this worker
+   * \param run RNG run number of the replication
+   * \param metrics at most MAX_METRICS metrics
+   */
+  void Publish (uint32_t slot, uint64_t run, const ScenarioMetrics &metrics)
+  {
+    NS_ABORT_MSG_IF (metrics.size () > MAX_METRICS, "Too many metrics to publish");
+    Slot &s = GetSlot (slot);
+    uint32_t seq = s.seq.load (std::memory_order_relaxed);
+    s.seq.store (seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+    s.run = run;
+    s.count = 0;
+    for (ScenarioMetrics::const_iterator m = metrics.begin (); m != metrics.end (); ++m)
+      {
+        NS_ABORT_MSG_IF (m->first.size () >= NAME_SIZE, "Metric name " << m->first << " too long");
+        std::strncpy (s.names[s.count], m->first.c_str (), NAME_SIZE);
+        s.values[s.count] = m->second;
+        s.count++;
+      }
+    s.seq.store (seq + 2, std::memory_order_release);
+  }
+
+  /**
+   * \brief Copy the metrics out of a slot.
+   * \param slot the slot
+   * \param run set to the RNG run number of the replication
+   * \param metrics filled with its metrics
+   * \return false if nothing complete was published; while the worker
+   * lives, it may be in the middle of writing, so try again
+   */
+  bool Read (uint32_t slot, uint64_t &run, ScenarioMetrics &metrics) const
+  {
+    const Slot &s = GetSlot (slot);
+    uint32_t before = s.seq.load (std::memory_order_acquire);
+    if (before == 0 || before % 2 == 1)
+      {
+        return false;
+      }
+    Slot copy;
+    copy.run = s.run;
+    copy.count = s.count;
+    std::memcpy (copy.names, s.names, sizeof (copy.names));
+    std::memcpy (copy.values, s.values, sizeof (copy.values));
+    std::atomic_thread_fence (std::memory_order_acquire);
+    if (s.seq.load (std::memory_order_relaxed) != before || copy.count > MAX_METRICS)
+      {
+        return false;
+      }
+    run = copy.run;
+    metrics.clear ();
+    for (uint32_t i = 0; i < copy.count; ++i)
+      {
+        copy.names[i][NAME_SIZE - 1] = '\0';
+        metrics[copy.names[i]] = copy.values[i];
+      }
+    return true;
+  }
+
+  /**
+   * \brief Empty a slot before it is handed to the next worker.
+   * \param slot the slot
+   */
+  void Clear (uint32_t slot)
+  {
+    GetSlot (slot).seq.store (0, std::memory_order_release);
+  }
+
+private:
+  /// Marks a shared memory object made by Create ().
+  static const uint32_t MAGIC = 0x6e733372;
+
+  /// Start of the shared memory object.
+  struct alignas (64) Header
+  {
+    uint32_t magic; //!< MAGIC
+    uint32_t slots; //!< number of slots that follow
+  };
+
+  /// Metrics of one replication, a cache line aligned.
+  struct alignas (64) Slot
+  {
+    std::atomic<uint32_t> seq;              //!< sequence count
+    uint32_t count;                         //!< metrics in use
+    uint64_t run;                           //!< RNG run number
+    char names[MAX_METRICS][NAME_SIZE];     //!< metric names
+    double values[MAX_METRICS];             //!< metric values
+  };
+
+  void Map (int fd)
+  {
+    void *p = mmap (0, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    NS_ABORT_MSG_IF (p == MAP_FAILED, "Cannot map shared memory " << m_name << ": " << std::strerror (errno));
+    m_header = static_cast<Header *> (p);
+  }
+
+  Slot &GetSlot (uint32_t slot) const
+  {
+    NS_ABORT_MSG_IF (slot >= m_header->slots, "No shared memory slot " << slot);
+    return reinterpret_cast<Slot *> (m_header + 1)[slot];
+  }
+
+  Header *m_header;   //!< mapped shared memory
+  size_t m_size;      //!< mapped size
+  std::string m_name; //!< shared memory object name
+  bool m_owner;       //!< whether this object made it and removes it
+};
+
+} // namespace ns3
+
+#endif /* REPLICATION_SHM_H */
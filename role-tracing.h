@@ -0,0 +1,457 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef ROLE_TRACING_H
+#define ROLE_TRACING_H
+
+//
+// Selective tracing by node role and layer.
+//
+// The scripts name groups of nodes ("backbone", "lan", "sta", ...) and then
+// ask for a comma-separated list of role:layer[-event] items, e.g.
+//
+//   --traceRoles=backbone:mac-drop,sta:app-rx
+//
+// Each item is resolved once, at setup, into TraceConnectWithoutContext
+// calls on the matching MAC, Ipv4L3Protocol and application objects of the
+// nodes in that role.  No Config path matching happens while the simulation
+// runs, and nothing is connected for roles or layers that were not asked for.
+//
+// Supported layers and events:
+//   mac: tx, rx, drop   (WifiMac and CsmaNetDevice)
+//   ip:  tx, rx, drop   (Ipv4L3Protocol)
+//   app: tx, rx         (OnOff, PacketSink, UdpEcho client and server)
+// Leaving out the event selects every event of that layer.  A trace
+// source is connected at most once per role, however many items select
+// it; a node in two roles, as with all:mac,backbone:mac, is traced once
+// under each, with separate counters.
+//
+// By default every traced packet becomes one line of text.  Two cheaper
+// outputs can be selected before Enable ():
+//   SetSampling (n)      only packets whose uid is a multiple of n are
+//                        traced; the uid travels with the packet, so a
+//                        sampled packet is traced at every hop
+//   SetAggregation (w)   packets and bytes are counted per role, node and
+//                        event in bins of width w, and one line per
+//                        non-empty counter is written when a bin closes
+//   SetUsdt ()           nothing is written; each packet fires the
+//                        ns3sim:packet probe instead (see usdt-probes.h)
+//
+
+#include <list>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/callback.h"
+#include "ns3/csma-net-device.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/log.h"
+#include "ns3/nstime.h"
+#include "ns3/node-container.h"
+#include "ns3/on-off-application.h"
+#include "ns3/output-stream-wrapper.h"
+#include "ns3/packet.h"
+#include "ns3/packet-sink.h"
+#include "ns3/simulator.h"
+#include "ns3/udp-echo-client.h"
+#include "ns3/udp-echo-server.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/wifi-net-device.h"
+
+#include "tick-time.h"
+#include "usdt-probes.h"
+
+namespace ns3 {
+
+/**
+ * \brief Connects trace sinks only on the nodes and layers selected by a
+ * role:layer[-event] specification.
+ *
+ * The tracer must outlive Simulator::Run (), since the connected sinks
+ * refer back to it.
+ */
+class RoleTracer
+{
+public:
+  RoleTracer ()
+    : m_sampling (1),
+      m_binWidth (Seconds (0)),
+      m_bin (0),
+      m_usdt (false)
+  {
+  }
+
+  /**
+   * \brief Trace only one packet in n, chosen by packet uid.
+   * \param n the sampling period; 1 traces every packet
+   */
+  void SetSampling (uint32_t n)
+  {
+    NS_ABORT_MSG_IF (n == 0, "Sampling period must be at least 1");
+    m_sampling = n;
+  }
+
+  /**
+   * \brief Count packets and bytes per role, node and event instead of writing
+   * one line per packet.
+   * \param binWidth the width of the counting bins
+   */
+  void SetAggregation (Time binWidth)
+  {
+    NS_ABORT_MSG_IF (!binWidth.IsStrictlyPositive (), "Aggregation bins must have a positive width");
+    m_binWidth = binWidth;
+  }
+
+  /**
+   * \brief Fire the ns3sim:packet probe for every traced packet instead of
+   * writing to the stream; no stream is needed.  Aborts in builds without
+   * <sys/sdt.h>, where there are no probes to fire.
+   */
+  void SetUsdt ()
+  {
+    NS_ABORT_MSG_IF (!ProbedScheduler::IsAvailable (), "Built without <sys/sdt.h>, no probes to fire");
+    m_usdt = true;
+  }
+
+  /**
+   * \brief Give a name to a group of nodes.
+   * \param name the role name used in the trace specification
+   * \param nodes the nodes playing that role
+   */
+  void AddRole (std::string name, NodeContainer nodes)
+  {
+    m_roles[name].Add (nodes);
+  }
+
+  /**
+   * \brief Resolve a trace specification into sink bindings.
+   * \param spec comma-separated role:layer[-event] items
+   * \param stream where the trace lines are written
+   */
+  void Enable (std::string spec, Ptr<OutputStreamWrapper> stream)
+  {
+    m_stream = stream;
+    std::istringstream items (spec);
+    std::string item;
+    while (std::getline (items, item, ','))
+      {
+        if (item.empty ())
+          {
+            continue;
+          }
+        std::string::size_type colon = item.find (':');
+        NS_ABORT_MSG_IF (colon == std::string::npos,
+                         "Trace item \"" << item << "\" is not role:layer[-event]");
+        std::string role = item.substr (0, colon);
+        std::string layer = item.substr (colon + 1);
+        std::string event;
+        std::string::size_type dash = layer.find ('-');
+        if (dash != std::string::npos)
+          {
+            event = layer.substr (dash + 1);
+            layer = layer.substr (0, dash);
+          }
+        std::map<std::string, NodeContainer>::const_iterator it = m_roles.find (role);
+        NS_ABORT_MSG_IF (it == m_roles.end (), "Unknown trace role \"" << role << "\"");
+        for (NodeContainer::Iterator n = it->second.Begin (); n != it->second.End (); ++n)
+          {
+            if (layer == "mac")
+              {
+                ConnectMac (role, *n, event);
+              }
+            else if (layer == "ip")
+              {
+                ConnectIp (role, *n, event);
+              }
+            else if (layer == "app")
+              {
+                ConnectApp (role, *n, event);
+              }
+            else
+              {
+                NS_ABORT_MSG ("Unknown trace layer \"" << layer << "\"");
+              }
+          }
+      }
+  }
+
+  /**
+   * \return the number of trace sources connected so far
+   */
+  uint32_t GetNBindings () const
+  {
+    return m_bindings.size ();
+  }
+
+  /**
+   * \brief Write out the counters of the last, still open, aggregation bin.
+   *
+   * Call once after Simulator::Run (); it only flushes the stream unless
+   * aggregation is enabled.
+   */
+  void Flush ()
+  {
+    if (m_stream == 0)
+      {
+        return;
+      }
+    if (m_binWidth.IsStrictlyPositive ())
+      {
+        FlushBin ();
+      }
+    m_stream->GetStream ()->flush ();
+  }
+
+private:
+  /// What a connected sink needs to know to label its output.
+  struct Binding
+  {
+    RoleTracer *tracer;   //!< owning tracer
+    std::string role;     //!< role of the traced node
+    std::string event;    //!< layer-event label, e.g. "mac-drop"
+    uint32_t node;        //!< traced node id
+    uint32_t counter;     //!< aggregation counter shared by role, node and event
+  };
+
+  /// Packets and bytes seen in the current bin for one role, node and event.
+  struct Counter
+  {
+    const Binding *binding; //!< first binding using this counter, for labels
+    uint64_t packets;       //!< packets in the current bin
+    uint64_t bytes;         //!< bytes in the current bin
+  };
+
+  /// Role, node and event of an aggregation counter.
+  typedef std::tuple<std::string, uint32_t, std::string> CounterKey;
+  /// Role, source object and trace source name of a connection.
+  typedef std::tuple<std::string, const Object *, std::string> Connection;
+
+  /// Whether this trace source is not yet connected for this role.
+  bool FirstConnection (std::string role, Ptr<Object> source, std::string name)
+  {
+    return m_connected.insert (Connection (role, PeekPointer (source), name)).second;
+  }
+
+  Binding *NewBinding (std::string role, Ptr<Node> node, std::string event)
+  {
+    Binding b;
+    b.tracer = this;
+    b.role = role;
+    b.event = event;
+    b.node = node->GetId ();
+    m_bindings.push_back (b);
+    // A node with several devices shares one counter per role and event
+    CounterKey key (role, b.node, event);
+    std::map<CounterKey, uint32_t>::const_iterator it = m_counterIndex.find (key);
+    if (it == m_counterIndex.end ())
+      {
+        Counter c;
+        c.binding = &m_bindings.back ();
+        c.packets = 0;
+        c.bytes = 0;
+        m_counterIndex[key] = m_counters.size ();
+        m_bindings.back ().counter = m_counters.size ();
+        m_counters.push_back (c);
+      }
+    else
+      {
+        m_bindings.back ().counter = it->second;
+      }
+    return &m_bindings.back ();
+  }
+
+  static bool Wants (std::string selected, std::string event)
+  {
+    return selected.empty () || selected == event;
+  }
+
+  void ConnectMac (std::string role, Ptr<Node> node, std::string event)
+  {
+    for (uint32_t i = 0; i < node->GetNDevices (); ++i)
+      {
+        Ptr<NetDevice> dev = node->GetDevice (i);
+        Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice> (dev);
+        Ptr<CsmaNetDevice> csma = DynamicCast<CsmaNetDevice> (dev);
+        if (wifi != 0)
+          {
+            Ptr<WifiMac> mac = wifi->GetMac ();
+            ConnectPacket (mac, "MacTx", role, node, "mac-tx", Wants (event, "tx"));
+            ConnectPacket (mac, "MacRx", role, node, "mac-rx", Wants (event, "rx"));
+            ConnectPacket (mac, "MacTxDrop", role, node, "mac-drop", Wants (event, "drop"));
+            ConnectPacket (mac, "MacRxDrop", role, node, "mac-drop", Wants (event, "drop"));
+          }
+        else if (csma != 0)
+          {
+            ConnectPacket (csma, "MacTx", role, node, "mac-tx", Wants (event, "tx"));
+            ConnectPacket (csma, "MacRx", role, node, "mac-rx", Wants (event, "rx"));
+            ConnectPacket (csma, "MacTxDrop", role, node, "mac-drop", Wants (event, "drop"));
+          }
+      }
+  }
+
+  void ConnectIp (std::string role, Ptr<Node> node, std::string event)
+  {
+    Ptr<Ipv4L3Protocol> ip = node->GetObject<Ipv4L3Protocol> ();
+    if (ip == 0)
+      {
+        return;
+      }
+    if (Wants (event, "tx") && FirstConnection (role, ip, "Tx"))
+      {
+        ip->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&RoleTracer::IpSink,
+                                                                 NewBinding (role, node, "ip-tx")));
+      }
+    if (Wants (event, "rx") && FirstConnection (role, ip, "Rx"))
+      {
+        ip->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&RoleTracer::IpSink,
+                                                                 NewBinding (role, node, "ip-rx")));
+      }
+    if (Wants (event, "drop") && FirstConnection (role, ip, "Drop"))
+      {
+        ip->TraceConnectWithoutContext ("Drop", MakeBoundCallback (&RoleTracer::IpDropSink,
+                                                                   NewBinding (role, node, "ip-drop")));
+      }
+  }
+
+  void ConnectApp (std::string role, Ptr<Node> node, std::string event)
+  {
+    for (uint32_t i = 0; i < node->GetNApplications (); ++i)
+      {
+        Ptr<Application> app = node->GetApplication (i);
+        if (DynamicCast<OnOffApplication> (app) != 0)
+          {
+            ConnectPacket (app, "Tx", role, node, "app-tx", Wants (event, "tx"));
+          }
+        else if (DynamicCast<UdpEchoClient> (app) != 0)
+          {
+            ConnectPacket (app, "Tx", role, node, "app-tx", Wants (event, "tx"));
+            ConnectPacket (app, "Rx", role, node, "app-rx", Wants (event, "rx"));
+          }
+        else if (DynamicCast<UdpEchoServer> (app) != 0)
+          {
+            ConnectPacket (app, "Rx", role, node, "app-rx", Wants (event, "rx"));
+          }
+        else if (DynamicCast<PacketSink> (app) != 0 && Wants (event, "rx")
+                 && FirstConnection (role, app, "Rx"))
+          {
+            app->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&RoleTracer::AddressSink,
+                                                                      NewBinding (role, node, "app-rx")));
+          }
+      }
+  }
+
+  void ConnectPacket (Ptr<Object> source, std::string name, std::string role,
+                      Ptr<Node> node, std::string label, bool wanted)
+  {
+    if (wanted && FirstConnection (role, source, name))
+      {
+        source->TraceConnectWithoutContext (name, MakeBoundCallback (&RoleTracer::PacketSinkFn,
+                                                                     NewBinding (role, node, label)));
+      }
+  }
+
+  void Record (const Binding *b, Ptr<const Packet> p)
+  {
+    if (m_sampling > 1 && p->GetUid () % m_sampling != 0)
+      {
+        return;
+      }
+    if (m_usdt)
+      {
+        NS3SIM_PROBE5 (packet, b->node, b->role.c_str (), b->event.c_str (), p->GetUid (), p->GetSize ());
+        return;
+      }
+    if (m_binWidth.IsStrictlyPositive ())
+      {
+        int64_t bin = Simulator::Now ().GetTimeStep () / m_binWidth.GetTimeStep ();
+        if (bin != m_bin)
+          {
+            FlushBin ();
+            m_bin = bin;
+          }
+        Counter &c = m_counters[b->counter];
+        if (c.packets == 0)
+          {
+            m_touched.push_back (b->counter);
+          }
+        c.packets++;
+        c.bytes += p->GetSize ();
+        return;
+      }
+    *m_stream->GetStream () << TickSeconds (Simulator::Now ()) << " " << b->role
+                            << " " << b->node << " " << b->event << " "
+                            << p->GetUid () << " " << p->GetSize () << std::endl;
+  }
+
+  /// Write one line per counter touched in the current bin and reset them.
+  void FlushBin ()
+  {
+    std::ostream *os = m_stream->GetStream ();
+    double start = TickSeconds (TimeStep (m_binWidth.GetTimeStep () * m_bin));
+    for (std::vector<uint32_t>::const_iterator i = m_touched.begin (); i != m_touched.end (); ++i)
+      {
+        Counter &c = m_counters[*i];
+        *os << start << " " << c.binding->role << " " << c.binding->node << " "
+            << c.binding->event << " " << c.packets << " " << c.bytes << "\n";
+        c.packets = 0;
+        c.bytes = 0;
+      }
+    m_touched.clear ();
+  }
+
+  static void PacketSinkFn (Binding *b, Ptr<const Packet> p)
+  {
+    b->tracer->Record (b, p);
+  }
+
+  static void AddressSink (Binding *b, Ptr<const Packet> p, const Address &)
+  {
+    b->tracer->Record (b, p);
+  }
+
+  static void IpSink (Binding *b, Ptr<const Packet> p, Ptr<Ipv4>, uint32_t)
+  {
+    b->tracer->Record (b, p);
+  }
+
+  static void IpDropSink (Binding *b, const Ipv4Header &, Ptr<const Packet> p,
+                          Ipv4L3Protocol::DropReason, Ptr<Ipv4>, uint32_t)
+  {
+    b->tracer->Record (b, p);
+  }
+
+  std::map<std::string, NodeContainer> m_roles; //!< named groups of nodes
+  std::list<Binding> m_bindings;  //!< bound sink state; addresses must stay stable
+  Ptr<OutputStreamWrapper> m_stream; //!< trace output
+  uint32_t m_sampling;            //!< trace one packet uid in m_sampling
+  Time m_binWidth;                //!< aggregation bin width, zero when disabled
+  int64_t m_bin;                  //!< index of the open aggregation bin
+  std::vector<Counter> m_counters; //!< one counter per traced role, node and event
+  std::map<CounterKey, uint32_t> m_counterIndex; //!< (role, node, event) to counter
+  std::set<Connection> m_connected;             //!< trace sources connected so far
+  std::vector<uint32_t> m_touched; //!< counters with packets in the open bin
+  bool m_usdt;                    //!< fire probes instead of writing
+};
+
+} // namespace ns3
+
+#endif /* ROLE_TRACING_H */
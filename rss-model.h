@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef RSS_MODEL_H
+#define RSS_MODEL_H
+
+//
+// Peak memory of a run predicted from its node count.
+//
+// Nearly all the memory of these scenarios is per node: devices, stacks,
+// routing tables and the events they keep scheduled.  RssModel fits peak
+// RSS = a + b * nodes by least squares to the peaks of earlier runs, and
+// adds the largest amount by which any of those runs exceeded the line,
+// so that every run seen so far would have been covered.  With runs of a
+// single size only, it scales their largest peak up with the node count
+// and never down.  No prediction is below the smallest peak measured.
+//
+// The samples are kept in a text file of "nodes peak-KiB" lines, so that
+// the calibration carries over from one sweep to the next.  Its first
+// line, "# key", says what the runs had in common besides their node
+// count, e.g. their other arguments; a file made for other runs is not
+// used, since those change the peak as much as the node count does.
+//
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Linear model of peak RSS against node count, calibrated from
+ * measured runs.
+ */
+class RssModel
+{
+public:
+  /// Samples kept; older ones are dropped first.
+  static const size_t MAX_SAMPLES = 1000;
+
+  /**
+   * \brief Read the samples of earlier sweeps, if the file exists and was
+   * made for the same runs.
+   * \param filename calibration file
+   * \param key what the runs have in common besides their node count; it
+   * must not contain a newline
+   * \return false if the file was made for runs of another key; none of
+   * its samples are used then
+   */
+  bool Load (std::string filename, std::string key)
+  {
+    m_key = key;
+    std::ifstream in (filename.c_str ());
+    std::string line;
+    if (!std::getline (in, line))
+      {
+        return true;
+      }
+    if (line != "# " + key)
+      {
+        return false;
+      }
+    uint32_t nodes;
+    uint64_t peakKiB;
+    while (in >> nodes >> peakKiB)
+      {
+        Add (nodes, peakKiB);
+      }
+    return true;
+  }
+
+  /**
+   * \brief Write all samples, replacing the file.
+   * \param filename calibration file
+   * \return false if it could not be written
+   */
+  bool Save (std::string filename) const
+  {
+    std::ofstream out (filename.c_str ());
+    out << "# " << m_key << "\n";
+    for (size_t i = 0; i < m_samples.size (); ++i)
+      {
+        out << m_samples[i].nodes << " " << m_samples[i].peakKiB << "\n";
+      }
+    return out.good ();
+  }
+
+  /**
+   * \brief Add a measured run; runs without nodes are ignored.
+   * \param nodes node count of the run
+   * \param peakKiB its peak RSS, e.g. ru_maxrss
+   */
+  void Add (uint32_t nodes, uint64_t peakKiB)
+  {
+    if (nodes == 0)
+      {
+        return;
+      }
+    Sample s;
+    s.nodes = nodes;
+    s.peakKiB = peakKiB;
+    m_samples.push_back (s);
+    Trim ();
+  }
+
+  /**
+   * \return whether there are samples to predict from
+   */
+  bool IsCalibrated (void) const
+  {
+    return !m_samples.empty ();
+  }
+
+  /**
+   * \brief Predict the peak RSS of a run.
+   * \param nodes node count of the run
+   * \return the predicted peak in KiB, 0 without samples (see IsCalibrated ())
+   */
+  uint64_t Predict (uint32_t nodes) const
+  {
+    if (m_samples.empty ())
+      {
+        return 0;
+      }
+    double n = m_samples.size ();
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    uint64_t least = m_samples[0].peakKiB;
+    for (size_t i = 0; i < m_samples.size (); ++i)
+      {
+        least = std::min (least, m_samples[i].peakKiB);
+        double x = m_samples[i].nodes;
+        double y = m_samples[i].peakKiB;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+      }
+    double det = n * sxx - sx * sx;
+    if (det <= 1e-9 * n * sxx)
+      {
+        // One size only: its largest peak, scaled up for larger runs
+        uint64_t peak = 0;
+        for (size_t i = 0; i < m_samples.size (); ++i)
+          {
+            peak = std::max (peak, m_samples[i].peakKiB);
+          }
+        double scale = std::max (1.0, static_cast<double> (nodes) / m_samples[0].nodes);
+        return peak * scale;
+      }
+    double b = std::max (0.0, (n * sxy - sx * sy) / det);
+    double a = (sy - b * sx) / n;
+    double excess = 0;
+    for (size_t i = 0; i < m_samples.size (); ++i)
+      {
+        excess = std::max (excess, m_samples[i].peakKiB - (a + b * m_samples[i].nodes));
+      }
+    return std::max (static_cast<double> (least), a + b * nodes + excess);
+  }
+
+private:
+  /// One measured run.
+  struct Sample
+  {
+    uint32_t nodes;   //!< node count
+    uint64_t peakKiB; //!< peak RSS
+  };
+
+  void Trim (void)
+  {
+    if (m_samples.size () > MAX_SAMPLES)
+      {
+        m_samples.erase (m_samples.begin (), m_samples.end () - MAX_SAMPLES);
+      }
+  }
+
+  std::vector<Sample> m_samples; //!< measured runs, oldest first
+  std::string m_key;             //!< what the runs have in common
+};
+
+} // namespace ns3
+
+#endif /* RSS_MODEL_H */
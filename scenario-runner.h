@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef SCENARIO_RUNNER_H
+#define SCENARIO_RUNNER_H
+
+//
+// Repeated runs of a scenario inside one process.
+//
+// A sweep of short runs spends much of its time starting processes:
+// loading the ns-3 libraries and running their static initializers.  The
+// ScenarioRunner instead calls a scenario function once per run and, in
+// between, puts the global simulator state back where a fresh process
+// would have it:
+//   Simulator::Destroy ()          scheduler, events, and with them the
+//                                  NodeList and ChannelList, so node ids
+//                                  start from 0 again
+//   Config::Reset ()               attribute defaults and global values,
+//                                  including the RNG seed and run number
+//   Ipv4AddressGenerator::Reset () addresses handed out by the helpers
+//   RngSeedManager::ResetNextStreamIndex ()
+//                                  streams assigned to random variables
+//                                  that were not given one explicitly
+//   Mac48Address::ResetAllocationIndex ()
+//                                  MAC addresses given to new devices
+// and then sets the run number of the next replication.  ns-3 releases
+// before 3.38 cannot reset the MAC address allocation; with those, Run ()
+// refuses to make more than one run, as the runs would not be the same as
+// single runs with the same RngRun.
+//
+// Config::Reset () also drops whatever the command line set, so the
+// runner calls a configure function before every run; it is the place for
+// the script's Config::SetDefault () calls and its CommandLine::Parse ().
+//
+// Other process-wide counters, such as packet uids and the uids of
+// events, keep counting across runs.  Whatever depends on them, e.g. the
+// packet uids written to the traces, differs from a fresh process.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ns3/config.h"
+#include "ns3/abort.h"
+#include "ns3/ipv4-address-generator.h"
+#include "ns3/mac48-address.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+/// Named results of one run, e.g. "events" or "echoReplies".
+typedef std::map<std::string, double> ScenarioMetrics;
+
+/**
+ * \brief Runs a scenario several times in this process, resetting the
+ * simulator between runs.
+ */
+class ScenarioRunner
+{
+public:
+  /// Builds the topology, runs the simulation and fills in its metrics.
+  typedef std::function<void (uint64_t run, ScenarioMetrics &metrics)> Scenario;
+  /// Applies attribute defaults and the command line before each run.
+  typedef std::function<void (void)> Configure;
+
+  ScenarioRunner ()
+    : m_configure ([] () {})
+  {
+  }
+
+  /**
+   * \brief Set the function that configures every run.
+   * \param configure called after the reset, before the scenario
+   */
+  void SetConfigure (Configure configure)
+  {
+    m_configure = configure;
+  }
+
+  /**
+   * \brief Run a scenario several times.
+   * \param scenario the scenario
+   * \param runs number of runs
+   * \param firstRun RNG run number of the first run; later runs count up
+   * \return the metrics of every run
+   *
+   * Besides what the scenario reports, the runner records "events" (as
+   * counted by the simulator) and "wallSeconds" (setup, run and metrics
+   * collection, without teardown) of every run.
+   */
+  std::vector<ScenarioMetrics> Run (Scenario scenario, uint32_t runs, uint64_t firstRun)
+  {
+    std::vector<ScenarioMetrics> results (runs);
+    for (uint32_t r = 0; r < runs; ++r)
+      {
+        if (r > 0)
+          {
+            NS_ABORT_MSG_IF (!Reset (), "This ns-3 cannot reset the MAC address allocation; "
+                             "make one run per process");
+          }
+        m_configure ();
+        RngSeedManager::SetRun (firstRun + r);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+        scenario (firstRun + r, results[r]);
+        results[r]["wallSeconds"] =
+          std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+        results[r]["events"] = Simulator::GetEventCount ();
+      }
+    Simulator::Destroy ();
+    return results;
+  }
+
+  /**
+   * \brief Return the simulator and the global configuration to the state
+   * of a freshly started process.
+   * \return false if the MAC address allocation could not be reset
+   */
+  static bool Reset (void)
+  {
+    Simulator::Destroy ();
+    Config::Reset ();
+    Ipv4AddressGenerator::Reset ();
+    RngSeedManager::ResetNextStreamIndex ();
+    return ResetMacAllocation<Mac48Address> (0);
+  }
+
+  /**
+   * \brief Print mean, minimum and maximum of every metric over the runs.
+   * \param os where to print
+   * \param results metrics returned by Run ()
+   */
+  static void PrintSummary (std::ostream &os, const std::vector<ScenarioMetrics> &results)
+  {
+    if (results.empty ())
+      {
+        return;
+      }
+    os << "metric mean min max (" << results.size () << " runs)" << std::endl;
+    for (ScenarioMetrics::const_iterator m = results[0].begin (); m != results[0].end (); ++m)
+      {
+        double sum = 0;
+        double lo = m->second;
+        double hi = m->second;
+        for (size_t r = 0; r < results.size (); ++r)
+          {
+            ScenarioMetrics::const_iterator v = results[r].find (m->first);
+            double value = v != results[r].end () ? v->second : 0;
+            sum += value;
+            lo = std::min (lo, value);
+            hi = std::max (hi, value);
+          }
+        os << m->first << " " << sum / results.size () << " " << lo << " " << hi << std::endl;
+      }
+  }
+
+private:
+  /// Reset the allocation of T, if T has the means (ns-3.38 and later).
+  template <typename T>
+  static auto ResetMacAllocation (int) -> decltype (T::ResetAllocationIndex (), bool ())
+  {
+    T::ResetAllocationIndex ();
+    return true;
+  }
+
+  /// Fallback for T without ResetAllocationIndex ().
+  template <typename T>
+  static bool ResetMacAllocation (long)
+  {
+    return false;
+  }
+
+  Configure m_configure; //!< applied before every run
+};
+
+} // namespace ns3
+
+#endif /* SCENARIO_RUNNER_H */
@@ -0,0 +1,200 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Measure the setup time of the infrastructure nets of the backbone
+// scripts, with the helpers configured per router (as the scripts used to)
+// and configured once (as they do now, see prebuilt-install.h).
+//
+//   ./setup-bench --routers=1000 --stasPerNet=9
+//
+// builds 1000 infrastructure nets of one access point and nine stations,
+// 10k nodes in all, in each mode, and prints the best and the median time
+// of each.  The builds are repeated --repeats times, alternating which
+// mode goes first, so that neither always finds the type registries and
+// the allocator warm.  Nothing is simulated.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/network-module.h"
+#include "ns3/yans-wifi-helper.h"
+
+#include "prebuilt-install.h"
+#include "scenario-runner.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SetupBench");
+
+static Ssid
+NetSsid (uint32_t i)
+{
+  std::stringstream ss;
+  ss << "wifi-infra" << i;
+  return Ssid (ss.str ());
+}
+
+static Ptr<ListPositionAllocator>
+NetPositions (uint32_t stas)
+{
+  Ptr<ListPositionAllocator> alloc = CreateObject<ListPositionAllocator> ();
+  for (uint32_t j = 0; j < stas; ++j)
+    {
+      alloc->Add (Vector (0.0, j * 10 + 10, 0.0));
+    }
+  return alloc;
+}
+
+//
+// Every helper is configured again for every net, from type names and
+// attribute strings.
+//
+static void
+BuildPerRouter (NodeContainer routers, uint32_t stasPerNet, YansWifiPhyHelper &wifiPhy,
+                YansWifiChannelHelper &wifiChannel, MobilityHelper &mobility)
+{
+  for (uint32_t i = 0; i < routers.GetN (); ++i)
+    {
+      NodeContainer stas;
+      stas.Create (stasPerNet);
+      WifiHelper wifiInfra;
+      WifiMacHelper macInfra;
+      wifiPhy.SetChannel (wifiChannel.Create ());
+      Ssid ssid = NetSsid (i);
+      macInfra.SetType ("ns3::StaWifiMac",
+                        "Ssid", SsidValue (ssid));
+      wifiInfra.Install (wifiPhy, macInfra, stas);
+      macInfra.SetType ("ns3::ApWifiMac",
+                        "Ssid", SsidValue (ssid));
+      wifiInfra.Install (wifiPhy, macInfra, routers.Get (i));
+      mobility.PushReferenceMobilityModel (routers.Get (i));
+      mobility.SetPositionAllocator (NetPositions (stasPerNet));
+      mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
+                                 "Bounds", RectangleValue (Rectangle (-10, 10, -10, 10)),
+                                 "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=3]"),
+                                 "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.4]"));
+      mobility.Install (stas);
+      mobility.PopReferenceMobilityModel ();
+    }
+}
+
+//
+// The helpers are configured once; only the channel, the SSID and the
+// reference position change per net.
+//
+static void
+BuildPrebuilt (NodeContainer routers, uint32_t stasPerNet, YansWifiPhyHelper &wifiPhy,
+               YansWifiChannelHelper &wifiChannel, MobilityHelper &mobility)
+{
+  WifiHelper wifiInfra;
+  WifiMacHelper macSta;
+  WifiMacHelper macAp;
+  macSta.SetType ("ns3::StaWifiMac");
+  macAp.SetType ("ns3::ApWifiMac");
+  mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
+                             "Bounds", RectangleValue (Rectangle (-10, 10, -10, 10)),
+                             "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=3]"),
+                             "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.4]"));
+  for (uint32_t i = 0; i < routers.GetN (); ++i)
+    {
+      NodeContainer stas;
+      stas.Create (stasPerNet);
+      wifiPhy.SetChannel (wifiChannel.Create ());
+      Ssid ssid = NetSsid (i);
+      InstallWithSsid (wifiInfra, wifiPhy, macSta, stas, ssid);
+      InstallWithSsid (wifiInfra, wifiPhy, macAp, routers.Get (i), ssid);
+      mobility.PushReferenceMobilityModel (routers.Get (i));
+      mobility.SetPositionAllocator (NetPositions (stasPerNet));
+      mobility.Install (stas);
+      mobility.PopReferenceMobilityModel ();
+    }
+}
+
+//
+// Build all nets in one mode and return how long it took, in seconds.
+//
+static double
+Measure (bool prebuilt, uint32_t nRouters, uint32_t stasPerNet)
+{
+  NodeContainer routers;
+  routers.Create (nRouters);
+  MobilityHelper mobility;
+  mobility.Install (routers);
+  YansWifiPhyHelper wifiPhy;
+  YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  if (prebuilt)
+    {
+      BuildPrebuilt (routers, stasPerNet, wifiPhy, wifiChannel, mobility);
+    }
+  else
+    {
+      BuildPerRouter (routers, stasPerNet, wifiPhy, wifiChannel, mobility);
+    }
+  return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t routers = 1000;
+  uint32_t stasPerNet = 9;
+  uint32_t repeats = 5;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("routers", "number of routers, i.e. of infrastructure nets", routers);
+  cmd.AddValue ("stasPerNet", "stations per infrastructure net", stasPerNet);
+  cmd.AddValue ("repeats", "builds in each mode", repeats);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (repeats == 0, "Need at least one build in each mode");
+  uint32_t nodes = routers * (stasPerNet + 1);
+  std::vector<double> times[2]; // per-router, prebuilt
+  for (uint32_t r = 0; r < repeats; ++r)
+    {
+      for (uint32_t m = 0; m < 2; ++m)
+        {
+          bool prebuilt = (r + m) % 2 == 1;
+          times[prebuilt].push_back (Measure (prebuilt, routers, stasPerNet));
+          ScenarioRunner::Reset ();
+        }
+    }
+
+  std::cout << "mode nodes best(s) median(s) us/node(best)" << std::endl;
+  const char *modes[2] = { "per-router", "prebuilt" };
+  for (uint32_t m = 0; m < 2; ++m)
+    {
+      std::sort (times[m].begin (), times[m].end ());
+      double best = times[m].front ();
+      double median = times[m][repeats / 2];
+      if (repeats % 2 == 0)
+        {
+          median = (median + times[m][repeats / 2 - 1]) / 2;
+        }
+      std::cout << modes[m] << " " << nodes << " " << best << " " << median << " "
+                << best * 1e6 / nodes << std::endl;
+    }
+  return 0;
+}
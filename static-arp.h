@@ -0,0 +1,123 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef STATIC_ARP_H
+#define STATIC_ARP_H
+
+//
+// Fill every ARP cache with permanent entries for all on-link neighbors,
+// so that no ARP request or reply is ever sent and the first packet of
+// each hop does not wait in the ARP queue.
+//
+// Two interfaces are on-link when their devices share a channel and their
+// addresses fall in the same subnet of the address plan.  Call this once
+// every address has been assigned.
+//
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "ns3/arp-cache.h"
+#include "ns3/channel.h"
+#include "ns3/ipv4-interface.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/log.h"
+#include "ns3/node-list.h"
+
+namespace ns3 {
+
+/**
+ * \brief Add permanent ARP entries for every on-link neighbor of every node.
+ * \return the number of entries added
+ */
+inline uint32_t
+PopulateArpCaches (void)
+{
+  typedef std::pair<Ipv4InterfaceAddress, Address> Neighbor;
+  std::map<Channel *, std::vector<Neighbor> > links;
+
+  // Who is attached to each channel, with which IP and MAC address
+  for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+    {
+      Ptr<Ipv4L3Protocol> ip = (*n)->GetObject<Ipv4L3Protocol> ();
+      if (ip == 0)
+        {
+          continue;
+        }
+      for (uint32_t i = 0; i < ip->GetNInterfaces (); ++i)
+        {
+          Ptr<NetDevice> dev = ip->GetNetDevice (i);
+          Ptr<Channel> channel = dev->GetChannel ();
+          if (channel == 0)
+            {
+              continue;
+            }
+          for (uint32_t a = 0; a < ip->GetNAddresses (i); ++a)
+            {
+              links[PeekPointer (channel)].push_back (Neighbor (ip->GetAddress (i, a), dev->GetAddress ()));
+            }
+        }
+    }
+
+  // Every interface learns the neighbors of its own subnet on its channel
+  uint32_t added = 0;
+  for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+    {
+      Ptr<Ipv4L3Protocol> ip = (*n)->GetObject<Ipv4L3Protocol> ();
+      if (ip == 0)
+        {
+          continue;
+        }
+      for (uint32_t i = 0; i < ip->GetNInterfaces (); ++i)
+        {
+          Ptr<Channel> channel = ip->GetNetDevice (i)->GetChannel ();
+          Ptr<ArpCache> cache = ip->GetInterface (i)->GetArpCache ();
+          if (channel == 0 || cache == 0)
+            {
+              continue;
+            }
+          const std::vector<Neighbor> &neighbors = links[PeekPointer (channel)];
+          for (uint32_t a = 0; a < ip->GetNAddresses (i); ++a)
+            {
+              Ipv4InterfaceAddress own = ip->GetAddress (i, a);
+              for (std::vector<Neighbor>::const_iterator nb = neighbors.begin (); nb != neighbors.end (); ++nb)
+                {
+                  Ipv4Address address = nb->first.GetLocal ();
+                  if (address == own.GetLocal ()
+                      || !own.GetMask ().IsMatch (address, own.GetLocal ()))
+                    {
+                      continue;
+                    }
+                  ArpCache::Entry *entry = cache->Lookup (address);
+                  if (entry == 0)
+                    {
+                      entry = cache->Add (address);
+                    }
+                  entry->SetMacAddress (nb->second);
+                  entry->MarkPermanent ();
+                  added++;
+                }
+            }
+        }
+    }
+  return added;
+}
+
+} // namespace ns3
+
+#endif /* STATIC_ARP_H */
@@ -71,8 +71,21 @@
 #include "ns3/packet-sink-helper.h"
 #include "ns3/olsr-helper.h"
 #include "ns3/csma-helper.h"
+#include "ns3/ipv4-list-routing.h"
+#include "ns3/ipv4-list-routing-helper.h"
+#include "ns3/ipv4-static-routing-helper.h"
+#include "ns3/olsr-routing-protocol.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-mac.h"
 #include "ns3/animation-interface.h"
 #include "random"
+#include <algorithm>
+#include <vector>
+
+#include "anim-writer.h"
+#include "flow-hash-gateway-routing.h"
+#include "static-arp.h"
 using namespace ns3;
 
 //
@@ -92,14 +105,61 @@ CourseChangeCallback (std::string path, Ptr<const MobilityModel> model)
   std::cout << "CourseChange " << path << " x=" << position.x << ", y=" << position.y << ", z=" << position.z << std::endl;
 }
 */
+
+//
+// Bytes sent by each clusterhead on the wireless backhaul
+//
+static std::vector<uint64_t> backhaulTxBytes;
+
+static void
+BackhaulTx(uint32_t head, Ptr<const Packet> packet)
+{
+  backhaulTxBytes[head] += packet->GetSize();
+}
+
+//
+// Packets and bytes each gateway forwards out of its cluster, i.e. onto
+// the clusterhead segment (interface 2); relaying inside the cluster is
+// not counted
+//
+static std::vector<uint64_t> gatewayPackets;
+static std::vector<uint64_t> gatewayBytes;
+
+static void
+GatewayForward(uint32_t gateway, const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+{
+  if (interface != 2)
+  {
+    return;
+  }
+  gatewayPackets[gateway]++;
+  gatewayBytes[gateway] += packet->GetSize();
+}
+
+//
+// Find the OLSR instance among the routing protocols of a node
+//
+static Ptr<olsr::RoutingProtocol>
+GetOlsrRouting(Ptr<Ipv4> ipv4)
+{
+  Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting>(ipv4->GetRoutingProtocol());
+  for (uint32_t k = 0; k < list->GetNRoutingProtocols(); ++k)
+  {
+    int16_t priority;
+    Ptr<olsr::RoutingProtocol> olsrRouting = DynamicCast<olsr::RoutingProtocol>(list->GetRoutingProtocol(k, priority));
+    if (olsrRouting != 0)
+    {
+      return olsrRouting;
+    }
+  }
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
   std::random_device rd;     // only used once to initialise (seed) engine
   std::mt19937 rng(rd());
 
-  CommandLine cmd(__FILE__);
-  cmd.Parse(argc, argv);
-
   Time::SetResolution(Time::NS);
   LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
   LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
@@ -110,6 +170,14 @@ int main(int argc, char *argv[])
   uint32_t clusterHeadNodes = 2;
   uint32_t infraNodes[clusterHeadNodes] = {4, 3};
   uint32_t stopTime = 20;
+  bool asyncAnim = false;
+  bool animTrace = false;
+  bool staticArp = false;
+  bool hierarchicalRouting = false;
+  uint32_t gatewaysPerCluster = 1;
+  bool wirelessBackhaul = false;
+  std::string backhaulMode = "VhtMcs8";
+  double backhaulGain = 15.0;
   //bool useCourseChangeCallback = false;
 
   //
@@ -119,11 +187,39 @@ int main(int argc, char *argv[])
   Config::SetDefault("ns3::OnOffApplication::PacketSize", StringValue("1472"));
   Config::SetDefault("ns3::OnOffApplication::DataRate", StringValue("100kb/s"));
 
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("stopTime", "simulation stop time (seconds)", stopTime);
+  cmd.AddValue("asyncAnim", "write the NetAnim file from a background thread instead of "
+               "using AnimationInterface", asyncAnim);
+  cmd.AddValue("animTrace", "record a binary animation trace (taller.anim) to be turned "
+               "into NetAnim XML later by anim-convert", animTrace);
+  cmd.AddValue("staticArp", "fill the ARP caches of all on-link neighbors before the run", staticArp);
+  cmd.AddValue("hierarchicalRouting", "run OLSR inside each cluster only and route between clusters "
+               "by cluster prefix through the clusterheads", hierarchicalRouting);
+  cmd.AddValue("gatewaysPerCluster", "number of gateway nodes per cluster; with more than one, "
+               "inter-cluster flows are spread over them by flow hash", gatewaysPerCluster);
+  cmd.AddValue("wirelessBackhaul", "join the clusterheads with a second wifi radio on a channel of "
+               "their own instead of a CSMA link", wirelessBackhaul);
+  cmd.AddValue("backhaulMode", "802.11ac data mode of the backhaul radios, VhtMcs0 to VhtMcs9 "
+               "(VhtMcs8 is 351 Mb/s on the 80 MHz channel)", backhaulMode);
+  cmd.AddValue("backhaulGain", "antenna gain of the backhaul radios, both ends (dBi)", backhaulGain);
+  cmd.Parse(argc, argv);
+
   if (stopTime < 10)
   {
     std::cout << "Use a simulation stop time >= 10 seconds" << std::endl;
     exit(1);
   }
+  if (gatewaysPerCluster == 0)
+  {
+    std::cout << "Every cluster needs at least one gateway" << std::endl;
+    exit(1);
+  }
+  if (gatewaysPerCluster > 1 && !hierarchicalRouting)
+  {
+    std::cout << "Several gateways per cluster need --hierarchicalRouting" << std::endl;
+    exit(1);
+  }
   ///////////////////////////////////////////////////////////////////////////
   //                                                                       //
   // Construct the Clusters                                                //
@@ -137,15 +233,62 @@ int main(int argc, char *argv[])
   // Assign IPv4 addresses to the device drivers (actually to the associated
   // IPv4 interfaces) we just created.
   //
+  const char *clusterNetworks[3] = {"192.167.0.0", "192.168.0.0", "192.169.0.0"};
   Ipv4AddressHelper ipAddrs[3];
-  ipAddrs[0].SetBase("192.167.0.0", "255.255.255.0");
-  ipAddrs[1].SetBase("192.168.0.0", "255.255.255.0");
-  ipAddrs[2].SetBase("192.169.0.0", "255.255.255.0");
+  for (int i = 0; i < 3; ++i)
+  {
+    ipAddrs[i].SetBase(clusterNetworks[i], "255.255.255.0");
+  }
+
+  //
+  // Create the clusters and pick random, distinct gateways (heads) in each
+  // one.  head_cluster holds the gateways of all clusters, cluster by
+  // cluster.
+  //
+  NodeContainer clusters[clusterHeadNodes];
+  NodeContainer gateways[clusterHeadNodes];
+  NodeContainer head_cluster = NodeContainer();
+  for (int i = 0; i < int(clusterHeadNodes); ++i)
+  {
+    clusters[i].Create(infraNodes[i]);
+    std::uniform_int_distribution<int> uni(0,infraNodes[i]-1); 
+    std::vector<bool> chosen(infraNodes[i], false);
+    while (gateways[i].GetN() < std::min(gatewaysPerCluster, infraNodes[i]))
+    {
+      auto random_integer = uni(rng);
+      if (!chosen[random_integer])
+      {
+        chosen[random_integer] = true;
+        gateways[i].Add(clusters[i].Get(random_integer));
+      }
+    }
+    head_cluster.Add(gateways[i]);
+  }
+
   OlsrHelper olsr;
+  Ipv4StaticRoutingHelper staticRouting;
+  Ipv4ListRoutingHelper listRouting;
   InternetStackHelper internet;
-  internet.SetRoutingHelper (olsr); // has effect on the next Install ()
+  if (hierarchicalRouting)
+  {
+    //
+    // Keep OLSR off the clusterhead segment, which will be interface 2 of
+    // every head (after loopback and the cluster wifi), and let static
+    // routes on the heads carry traffic between clusters
+    //
+    for (uint32_t i = 0; i < head_cluster.GetN(); ++i)
+    {
+      olsr.ExcludeInterface(head_cluster.Get(i), 2);
+    }
+    listRouting.Add(staticRouting, 0);
+    listRouting.Add(olsr, 10);
+    internet.SetRoutingHelper(listRouting); // has effect on the next Install ()
+  }
+  else
+  {
+    internet.SetRoutingHelper (olsr); // has effect on the next Install ()
+  }
 
-  NodeContainer clusters[clusterHeadNodes];
   NetDeviceContainer clusterDevices[clusterHeadNodes];
   WifiHelper wifi;
   WifiMacHelper mac;
@@ -155,14 +298,11 @@ int main(int argc, char *argv[])
   YansWifiPhyHelper wifiPhy;
   YansWifiChannelHelper wifiChannel[clusterHeadNodes];
 
-  NodeContainer head_cluster = NodeContainer();
   for (int i = 0; i < int(clusterHeadNodes); ++i)
   {
     wifiChannel[i] = YansWifiChannelHelper::Default();
     wifiPhy.SetChannel(wifiChannel[i].Create());
 
-    clusters[i].Create(infraNodes[i]);    
-
     clusterDevices[i] = wifi.Install(wifiPhy, mac, clusters[i]);
     //
     // Add the IPv4 protocol stack to the nodes in our container
@@ -211,9 +351,6 @@ int main(int argc, char *argv[])
         }
       }
     }*/
-    std::uniform_int_distribution<int> uni(0,infraNodes[i]-1); 
-    auto random_integer = uni(rng);
-    head_cluster.Add(clusters[i].Get(random_integer));
   }
 
   Ipv4AddressHelper ipAddrsH;
@@ -221,11 +358,49 @@ int main(int argc, char *argv[])
   // the "172.16 address space
   ipAddrsH.SetBase ("172.16.0.0", "255.255.255.0");
 
-  CsmaHelper csma;
-  csma.SetChannelAttribute ("DataRate",
-                            DataRateValue (DataRate (5000000)));
-  csma.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (2)));
-  NetDeviceContainer head_clusterDevices = csma.Install (head_cluster);
+  NetDeviceContainer head_clusterDevices;
+  if (wirelessBackhaul)
+  {
+    //
+    // The heads move independently, so instead of a wire they get a
+    // second radio on a separate channel.  High-gain antennas and a
+    // free-space path loss exponent stand in for a directional long-range
+    // link.  The backhaul is 802.11ac on an 80 MHz channel, well above
+    // the 802.11a rates inside the clusters; the rate is fixed so the
+    // backhaul is a known bottleneck.
+    //
+    YansWifiChannelHelper backhaulChannel;
+    backhaulChannel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+    backhaulChannel.AddPropagationLoss("ns3::LogDistancePropagationLossModel",
+                                       "Exponent", DoubleValue(2.0));
+    YansWifiPhyHelper backhaulPhy;
+    backhaulPhy.SetChannel(backhaulChannel.Create());
+    backhaulPhy.Set("TxGain", DoubleValue(backhaulGain));
+    backhaulPhy.Set("RxGain", DoubleValue(backhaulGain));
+    WifiHelper backhaulWifi;
+    backhaulWifi.SetStandard(WIFI_STANDARD_80211ac);
+    backhaulWifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
+                                         "DataMode", StringValue(backhaulMode),
+                                         "ControlMode", StringValue("OfdmRate6Mbps"));
+    WifiMacHelper backhaulMac;
+    backhaulMac.SetType("ns3::AdhocWifiMac");
+    head_clusterDevices = backhaulWifi.Install(backhaulPhy, backhaulMac, head_cluster);
+
+    backhaulTxBytes.assign(head_clusterDevices.GetN(), 0);
+    for (uint32_t i = 0; i < head_clusterDevices.GetN(); ++i)
+    {
+      Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(head_clusterDevices.Get(i));
+      dev->GetMac()->TraceConnectWithoutContext("MacTx", MakeBoundCallback(&BackhaulTx, i));
+    }
+  }
+  else
+  {
+    CsmaHelper csma;
+    csma.SetChannelAttribute ("DataRate",
+                              DataRateValue (DataRate (5000000)));
+    csma.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (2)));
+    head_clusterDevices = csma.Install (head_cluster);
+  }
   //
   // Assign IPv4 addresses to the device drivers (actually to the
   // associated IPv4 interfaces) we just created.
@@ -237,6 +412,95 @@ int main(int argc, char *argv[])
   //
   ipAddrsH.NewNetwork ();
 
+  if (hierarchicalRouting)
+  {
+    //
+    // Each head reaches every other cluster through one of that cluster's
+    // heads, with one route per cluster prefix, and announces those
+    // prefixes and the head segment into its own cluster as OLSR HNA.
+    // Cluster members thus hold host routes for their own cluster only.
+    //
+    Ipv4Mask clusterMask("255.255.255.0");
+    for (uint32_t i = 0; i < clusterHeadNodes; ++i)
+    {
+      for (uint32_t k = 0; k < gateways[i].GetN(); ++k)
+      {
+        Ptr<Ipv4> ipv4 = gateways[i].Get(k)->GetObject<Ipv4>();
+        Ptr<Ipv4StaticRouting> headStatic = staticRouting.GetStaticRouting(ipv4);
+        Ptr<olsr::RoutingProtocol> headOlsr = GetOlsrRouting(ipv4);
+        headOlsr->AddHostNetworkAssociation(Ipv4Address("172.16.0.0"), clusterMask);
+        for (uint32_t j = 0; j < clusterHeadNodes; ++j)
+        {
+          if (i == j)
+          {
+            continue;
+          }
+          Ptr<Node> remoteGateway = gateways[j].Get(k % gateways[j].GetN());
+          Ipv4Address remoteHead = remoteGateway->GetObject<Ipv4>()->GetAddress(2, 0).GetLocal();
+          headStatic->AddNetworkRouteTo(Ipv4Address(clusterNetworks[j]), clusterMask, remoteHead, 2);
+          headOlsr->AddHostNetworkAssociation(Ipv4Address(clusterNetworks[j]), clusterMask);
+        }
+      }
+    }
+
+    if (gatewaysPerCluster > 1)
+    {
+      //
+      // HNA alone would send every flow to the nearest gateway.  Instead,
+      // every cluster node hashes each outgoing flow onto one of its
+      // cluster's gateways, ahead of OLSR; the gateways hand the flows to
+      // their static routes.
+      //
+      for (uint32_t i = 0; i < clusterHeadNodes; ++i)
+      {
+        for (uint32_t n = 0; n < clusters[i].GetN(); ++n)
+        {
+          Ptr<Node> node = clusters[i].Get(n);
+          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+          Ptr<FlowHashGatewayRouting> flowHash = CreateObject<FlowHashGatewayRouting>();
+          flowHash->SetCluster(Ipv4Address(clusterNetworks[i]), clusterMask);
+          bool isGateway = false;
+          for (uint32_t k = 0; k < gateways[i].GetN(); ++k)
+          {
+            flowHash->AddGateway(gateways[i].Get(k)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal());
+            isGateway = isGateway || gateways[i].Get(k) == node;
+          }
+          if (isGateway)
+          {
+            flowHash->SetRoutingProtocols(GetOlsrRouting(ipv4), staticRouting.GetStaticRouting(ipv4));
+          }
+          else
+          {
+            flowHash->SetRoutingProtocols(GetOlsrRouting(ipv4), 0);
+          }
+          DynamicCast<Ipv4ListRouting>(ipv4->GetRoutingProtocol())->AddRoutingProtocol(flowHash, 20);
+        }
+      }
+    }
+
+    //
+    // Count what every gateway forwards between clusters, to see how evenly
+    // the load spreads
+    //
+    gatewayPackets.assign(head_cluster.GetN(), 0);
+    gatewayBytes.assign(head_cluster.GetN(), 0);
+    for (uint32_t g = 0; g < head_cluster.GetN(); ++g)
+    {
+      head_cluster.Get(g)->GetObject<Ipv4L3Protocol>()->TraceConnectWithoutContext("UnicastForward",
+                                                                                   MakeBoundCallback(&GatewayForward, g));
+    }
+  }
+
+  if (staticArp)
+  {
+    //
+    // Every address is assigned by now, so the ARP caches of the cluster
+    // WLANs and of the clusterhead segment can be filled from the address
+    // plan instead of by ARP exchanges
+    //
+    uint32_t arpEntries = PopulateArpCaches();
+    NS_LOG_INFO("Added " << arpEntries << " static ARP entries");
+  }
 
   /*
   ///////////////////////////////////////////////////////////////////////////
@@ -309,7 +573,22 @@ int main(int argc, char *argv[])
       Config::Connect ("/NodeList/$ns3::MobilityModel/CourseChange", MakeCallback (&CourseChangeCallback));
     }
 */
-  AnimationInterface anim("taller.xml");
+  AnimationInterface *anim = 0;
+  AnimWriter animWriter;
+  if (animTrace)
+  {
+    animWriter.Open("taller.anim", AnimWriter::BINARY);
+    animWriter.Install(NodeContainer::GetGlobal());
+  }
+  else if (asyncAnim)
+  {
+    animWriter.Open("taller.xml");
+    animWriter.Install(NodeContainer::GetGlobal());
+  }
+  else
+  {
+    anim = new AnimationInterface("taller.xml");
+  }
 
   ///////////////////////////////////////////////////////////////////////////
   //                                                                       //
@@ -320,5 +599,17 @@ int main(int argc, char *argv[])
   NS_LOG_INFO("Run Simulation.");
   Simulator::Stop(Seconds(stopTime));
   Simulator::Run();
+  for (uint32_t i = 0; i < backhaulTxBytes.size(); ++i)
+  {
+    std::cout << "Backhaul head " << head_cluster.Get(i)->GetId() << " sent " << backhaulTxBytes[i]
+              << " bytes (" << backhaulTxBytes[i] * 8 / (stopTime * 1000.0) << " kb/s)" << std::endl;
+  }
+  for (uint32_t g = 0; g < gatewayPackets.size(); ++g)
+  {
+    std::cout << "Gateway " << head_cluster.Get(g)->GetId() << " forwarded " << gatewayPackets[g]
+              << " packets, " << gatewayBytes[g] << " bytes out of its cluster" << std::endl;
+  }
+  animWriter.Close();
   Simulator::Destroy();
+  delete anim;
 }
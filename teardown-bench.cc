@@ -0,0 +1,128 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Measure how long the teardown of a topology takes, as a function of its
+// size.
+//
+//   ./teardown-bench --sizes=1000,2000,5000,10000
+//
+// For every size, a topology shaped like the backbone scripts is built:
+// nodes with an ad hoc wifi device on one shared channel, grouped into
+// wired LANs, all with an IPv4 stack and OLSR.  It runs for a simulated
+// millisecond, so that every object is initialized, then
+// Simulator::Destroy () is timed; it disposes and releases every node with
+// all it holds.  That is the time --fastExit saves at the end of a run.
+//
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "ns3/core-module.h"
+#include "ns3/csma-helper.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-generator.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/network-module.h"
+#include "ns3/olsr-helper.h"
+#include "ns3/yans-wifi-helper.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TeardownBench");
+
+//
+// Build a topology of the given size and start it.
+//
+static void
+Build (uint32_t nodes, uint32_t lanSize)
+{
+  NodeContainer all;
+  all.Create (nodes);
+
+  WifiHelper wifi;
+  WifiMacHelper mac;
+  mac.SetType ("ns3::AdhocWifiMac");
+  YansWifiPhyHelper wifiPhy;
+  YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
+  wifiPhy.SetChannel (wifiChannel.Create ());
+  NetDeviceContainer wifiDevices = wifi.Install (wifiPhy, mac, all);
+
+  OlsrHelper olsr;
+  InternetStackHelper internet;
+  internet.SetRoutingHelper (olsr);
+  internet.Install (all);
+
+  Ipv4AddressHelper ipAddrs;
+  ipAddrs.SetBase ("10.0.0.0", "255.0.0.0");
+  ipAddrs.Assign (wifiDevices);
+
+  CsmaHelper csma;
+  ipAddrs.SetBase ("172.16.0.0", "255.255.255.0");
+  for (uint32_t first = 0; first < nodes; first += lanSize)
+    {
+      NodeContainer lan;
+      for (uint32_t n = first; n < nodes && n < first + lanSize; ++n)
+        {
+          lan.Add (all.Get (n));
+        }
+      ipAddrs.Assign (csma.Install (lan));
+      ipAddrs.NewNetwork ();
+    }
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
+                                 "DeltaX", DoubleValue (20.0),
+                                 "DeltaY", DoubleValue (20.0),
+                                 "GridWidth", UintegerValue (100));
+  mobility.Install (all);
+
+  Simulator::Stop (MilliSeconds (1));
+  Simulator::Run ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string sizes = "1000,2000,5000,10000";
+  uint32_t lanSize = 10;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("sizes", "comma-separated node counts to measure", sizes);
+  cmd.AddValue ("lanSize", "nodes per wired LAN", lanSize);
+  cmd.Parse (argc, argv);
+
+  std::cout << "nodes build+run(s) teardown(s)" << std::endl;
+  std::istringstream list (sizes);
+  std::string item;
+  while (std::getline (list, item, ','))
+    {
+      uint32_t nodes = std::stoul (item);
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      Build (nodes, lanSize);
+      std::chrono::steady_clock::time_point built = std::chrono::steady_clock::now ();
+      Simulator::Destroy ();
+      std::chrono::steady_clock::time_point destroyed = std::chrono::steady_clock::now ();
+      Ipv4AddressGenerator::Reset ();
+      std::cout << nodes << " "
+                << std::chrono::duration<double> (built - start).count () << " "
+                << std::chrono::duration<double> (destroyed - built).count () << std::endl;
+    }
+  return 0;
+}
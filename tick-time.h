@@ -0,0 +1,96 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TICK_TIME_H
+#define TICK_TIME_H
+
+//
+// Time conversions on the integer tick count.
+//
+// A Time is an integer number of ticks of the global resolution
+// (nanoseconds by default, or as set by Time::SetResolution ()).
+// Time::GetSeconds () and DataRate::CalculateBytesTxTime () convert
+// through int64x64_t fixed point, and Seconds (double) back.  The
+// functions here work on the tick count directly: one double division to
+// get seconds, integer arithmetic for transmission times.  The trace
+// sinks of these scripts use TickSeconds () for the timestamps of every
+// line.
+//
+// The resolution must be set before the first call; the scripts set it,
+// if at all, first thing in main ().
+//
+
+#include <cstdint>
+
+#include "ns3/abort.h"
+#include "ns3/assert.h"
+#include "ns3/data-rate.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * \return the number of ticks in a second at the current resolution
+ */
+inline int64_t
+TicksPerSecond (void)
+{
+  static const int64_t ticks = Seconds (1).GetTimeStep ();
+  return ticks;
+}
+
+/**
+ * \brief Same as t.GetSeconds (), without fixed point arithmetic.
+ * \param t the time
+ * \return the time in seconds
+ *
+ * Exact to the last bit of the double for any time below 2^53 ticks.
+ */
+inline double
+TickSeconds (Time t)
+{
+  static const double ticksPerSecond = TicksPerSecond ();
+  return t.GetTimeStep () / ticksPerSecond;
+}
+
+/**
+ * \brief Same as rate.CalculateBytesTxTime (bytes), in integer ticks.
+ * \param bytes the frame size
+ * \param rate the transmission rate
+ * \return the transmission time, rounded to the nearest tick
+ *
+ * The product of bits and ticks per second is taken in 128 bits, since
+ * at fine resolutions it does not fit in 64: at Time::FS, frames over
+ * about 2300 bytes would overflow.
+ *
+ * No script uses it; it is here for time-bench, which compares it with
+ * CalculateBytesTxTime ().
+ */
+inline Time
+TickTxTime (uint32_t bytes, DataRate rate)
+{
+  NS_ABORT_MSG_IF (rate.GetBitRate () == 0, "No transmission time at a rate of 0 b/s");
+  __extension__ typedef unsigned __int128 uint128_t;
+  uint128_t bps = rate.GetBitRate ();
+  uint128_t ticks = (static_cast<uint128_t> (bytes) * 8 * TicksPerSecond () + bps / 2) / bps;
+  NS_ASSERT_MSG (ticks <= static_cast<uint64_t> (INT64_MAX), "Transmission time out of range");
+  return TimeStep (static_cast<uint64_t> (ticks));
+}
+
+} // namespace ns3
+
+#endif /* TICK_TIME_H */
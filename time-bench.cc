@@ -0,0 +1,113 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+//
+// Compare the cost of the Time conversions made for every traced packet
+// and every transmitted frame, through ns-3's fixed point arithmetic and
+// through the integer tick count (tick-time.h).
+//
+//   ./time-bench --iterations=10000000
+//
+// Prints nanoseconds per operation for each pair, and first checks that
+// both ways agree, to the last bit of a double or to one tick.
+//
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+#include "tick-time.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TimeBench");
+
+// Keeps the compiler from dropping the benchmarked work
+static volatile double g_sink;
+
+//
+// Time `iterations` calls of op (i) and return nanoseconds per call.
+//
+template <typename Op>
+static double
+Measure (uint64_t iterations, Op op)
+{
+  double sum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint64_t i = 0; i < iterations; ++i)
+    {
+      sum += op (i);
+    }
+  double elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  g_sink = sum;
+  return elapsed * 1e9 / iterations;
+}
+
+static void
+Report (std::string name, double fixedPoint, double ticks)
+{
+  std::cout << name << " " << fixedPoint << " " << ticks << " " << fixedPoint / ticks << std::endl;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint64_t iterations = 10000000;
+  bool nanoseconds = true;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("iterations", "operations per measurement", iterations);
+  cmd.AddValue ("nanoseconds", "set the time resolution to nanoseconds, as taller does", nanoseconds);
+  cmd.Parse (argc, argv);
+
+  if (nanoseconds)
+    {
+      Time::SetResolution (Time::NS);
+    }
+
+  // Timestamps a few microseconds apart, as packet events are
+  Time base = Seconds (12.5);
+  DataRate rate ("5Mbps");
+  for (uint64_t i = 0; i < 100000; ++i)
+    {
+      Time t = base + NanoSeconds (i * 3711);
+      // Both round once, from different intermediate values
+      NS_ABORT_MSG_IF (std::abs (t.GetSeconds () - TickSeconds (t)) > 1e-15 * t.GetSeconds (),
+                       "TickSeconds differs at " << t);
+      uint32_t bytes = 64 + i % 1436;
+      NS_ABORT_MSG_IF (std::abs ((rate.CalculateBytesTxTime (bytes) - TickTxTime (bytes, rate)).GetTimeStep ()) > 1,
+                       "TickTxTime differs for " << bytes << " bytes");
+    }
+
+  std::cout << "operation fixed-point(ns) ticks(ns) speedup" << std::endl;
+  Report ("seconds",
+          Measure (iterations, [base] (uint64_t i) { return (base + TimeStep (i)).GetSeconds (); }),
+          Measure (iterations, [base] (uint64_t i) { return TickSeconds (base + TimeStep (i)); }));
+  Report ("tx-time",
+          Measure (iterations, [rate] (uint64_t i)
+            {
+              return static_cast<double> (rate.CalculateBytesTxTime (64 + i % 1436).GetTimeStep ());
+            }),
+          Measure (iterations, [rate] (uint64_t i)
+            {
+              return static_cast<double> (TickTxTime (64 + i % 1436, rate).GetTimeStep ());
+            }));
+  return 0;
+}
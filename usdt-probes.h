@@ -0,0 +1,177 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef USDT_PROBES_H
+#define USDT_PROBES_H
+
+//
+// Static tracepoints (USDT) for perf and bpftrace, under the provider
+// "ns3sim":
+//
+//   event_insert   (ts, uid, context)         an event is scheduled
+//   event_dispatch (ts, uid, context, type)   an event is about to run
+//   event_remove   (ts, uid, context)         an event is removed early
+//   packet         (node, role, event, uid, size)
+//                                             a packet passes a traced
+//                                             layer (RoleTracer, usdt mode)
+//
+// ts is in simulator time steps, context is the id of the node the event
+// belongs to (0xffffffff for none), type is the mangled C++ type of the
+// event implementation, which names the function the event calls, and
+// role and event are strings such as "backbone" and "mac-rx".  E.g.
+//
+//   bpftrace -e 'usdt:./mixed-wired-wireless:ns3sim:event_dispatch
+//                { @[arg2, str(arg3)] = count (); }'
+//
+// counts executed events per node and per callee.
+//
+// The event probes sit in ProbedScheduler, which wraps the scheduler that
+// actually orders the events and is only installed on request
+// (Simulator::SetScheduler), so runs that do not ask for probes keep the
+// scheduler they always had.  Each probe itself is a single nop until a
+// tracer attaches to it.  Every probe has a semaphore, which the tracers
+// that support them (bpftrace does) count up while attached; the type of
+// event_dispatch is only looked up then, and is null for other tracers.
+// Without <sys/sdt.h> the probes compile to nothing.
+//
+
+#include <string>
+#include <typeinfo>
+
+#include "ns3/event-impl.h"
+#include "ns3/object-factory.h"
+#include "ns3/scheduler.h"
+#include "ns3/string.h"
+
+#if defined (__has_include)
+#if __has_include (<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define NS3SIM_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef NS3SIM_HAVE_USDT
+// Outside any namespace: the probes refer to them by their plain names
+#define NS3SIM_SEMAPHORE(name) \
+  __extension__ unsigned short ns3sim_##name##_semaphore __attribute__ ((weak, section (".probes")))
+NS3SIM_SEMAPHORE (event_insert);
+NS3SIM_SEMAPHORE (event_dispatch);
+NS3SIM_SEMAPHORE (event_remove);
+NS3SIM_SEMAPHORE (packet);
+#define NS3SIM_ENABLED(name) __builtin_expect (ns3sim_##name##_semaphore != 0, 0)
+#define NS3SIM_PROBE3(name, a, b, c) DTRACE_PROBE3 (ns3sim, name, a, b, c)
+#define NS3SIM_PROBE4(name, a, b, c, d) DTRACE_PROBE4 (ns3sim, name, a, b, c, d)
+#define NS3SIM_PROBE5(name, a, b, c, d, e) DTRACE_PROBE5 (ns3sim, name, a, b, c, d, e)
+#else
+#define NS3SIM_ENABLED(name) false
+#define NS3SIM_PROBE3(name, a, b, c)
+#define NS3SIM_PROBE4(name, a, b, c, d)
+#define NS3SIM_PROBE5(name, a, b, c, d, e)
+#endif
+
+namespace ns3 {
+
+/**
+ * \brief A scheduler that fires the ns3sim event probes and leaves the
+ * ordering of the events to another scheduler.
+ */
+class ProbedScheduler : public Scheduler
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::ProbedScheduler")
+      .SetParent<Scheduler> ()
+      .SetGroupName ("Core")
+      .AddConstructor<ProbedScheduler> ()
+      .AddAttribute ("Inner",
+                     "The type of the scheduler that orders the events.",
+                     StringValue ("ns3::MapScheduler"),
+                     MakeStringAccessor (&ProbedScheduler::m_innerType),
+                     MakeStringChecker ())
+    ;
+    return tid;
+  }
+
+  /**
+   * \return whether the probes were compiled in
+   */
+  static bool IsAvailable (void)
+  {
+#ifdef NS3SIM_HAVE_USDT
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // Inherited from Scheduler
+  void Insert (const Event &ev)
+  {
+    NS3SIM_PROBE3 (event_insert, ev.key.m_ts, ev.key.m_uid, ev.key.m_context);
+    m_inner->Insert (ev);
+  }
+
+  bool IsEmpty (void) const
+  {
+    return m_inner->IsEmpty ();
+  }
+
+  Event PeekNext (void) const
+  {
+    return m_inner->PeekNext ();
+  }
+
+  Event RemoveNext (void)
+  {
+    // The simulator runs every event right after taking it off the queue
+    Event ev = m_inner->RemoveNext ();
+    NS3SIM_PROBE4 (event_dispatch, ev.key.m_ts, ev.key.m_uid, ev.key.m_context,
+                   NS3SIM_ENABLED (event_dispatch) ? typeid (*ev.impl).name () : 0);
+    return ev;
+  }
+
+  void Remove (const Event &ev)
+  {
+    NS3SIM_PROBE3 (event_remove, ev.key.m_ts, ev.key.m_uid, ev.key.m_context);
+    m_inner->Remove (ev);
+  }
+
+protected:
+  void NotifyConstructionCompleted (void)
+  {
+    Scheduler::NotifyConstructionCompleted ();
+    ObjectFactory factory;
+    factory.SetTypeId (m_innerType);
+    m_inner = factory.Create<Scheduler> ();
+  }
+
+private:
+  std::string m_innerType;  //!< type of the wrapped scheduler
+  Ptr<Scheduler> m_inner;   //!< the wrapped scheduler
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ProbedScheduler);
+
+} // namespace ns3
+
+#endif /* USDT_PROBES_H */